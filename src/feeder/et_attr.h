@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "et_def.pb.h"
+
+namespace Chakra {
+
+// Attribute names the feeder knows about. Each gets a dense AttrId, so that
+// nodes can keep their known attributes in an array instead of a hash map.
+// New names can be added anywhere in the list.
+#define CHAKRA_KNOWN_ATTRS(X) \
+  X(is_cpu_op)                \
+  X(num_ops)                  \
+  X(tensor_loc)               \
+  X(tensor_size)              \
+  X(comm_type)                \
+  X(comm_priority)            \
+  X(comm_size)                \
+  X(comm_src)                 \
+  X(comm_dst)                 \
+  X(comm_tag)                 \
+  X(pg_name)                  \
+  X(rf_id)                    \
+  X(fw_parent)                \
+  X(fw_tid)                   \
+  X(seq_id)                   \
+  X(scope)                    \
+  X(tid)                      \
+  X(op_schema)                \
+  X(bottom_level)             \
+  X(slack)
+
+enum class AttrId : uint8_t {
+#define CHAKRA_ATTR_ID(name) name,
+  CHAKRA_KNOWN_ATTRS(CHAKRA_ATTR_ID)
+#undef CHAKRA_ATTR_ID
+      Unknown
+};
+
+constexpr size_t kNumAttrIds = static_cast<size_t>(AttrId::Unknown);
+
+constexpr std::string_view kAttrNames[kNumAttrIds] = {
+#define CHAKRA_ATTR_NAME(name) #name,
+    CHAKRA_KNOWN_ATTRS(CHAKRA_ATTR_NAME)
+#undef CHAKRA_ATTR_NAME
+};
+
+// Names are mapped to IDs through a perfect hash: FNV-1a with the first seed
+// that sends every known name to its own slot, found at compile time
+constexpr size_t kAttrHashSlots = 64;
+static_assert(
+    kAttrHashSlots >= 2 * kNumAttrIds,
+    "Too many known attributes for the hash table");
+
+constexpr uint32_t attrHash(std::string_view name, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;
+  for (char c : name) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  return hash & (kAttrHashSlots - 1);
+}
+
+constexpr bool isPerfectAttrSeed(uint32_t seed) {
+  bool used[kAttrHashSlots] = {};
+  for (std::string_view name : kAttrNames) {
+    uint32_t slot = attrHash(name, seed);
+    if (used[slot]) {
+      return false;
+    }
+    used[slot] = true;
+  }
+  return true;
+}
+
+constexpr uint32_t findPerfectAttrSeed() {
+  uint32_t seed = 0;
+  while (!isPerfectAttrSeed(seed)) {
+    ++seed;
+  }
+  return seed;
+}
+
+constexpr uint32_t kAttrHashSeed = findPerfectAttrSeed();
+
+struct AttrHashTable {
+  AttrId slots[kAttrHashSlots];
+};
+
+constexpr AttrHashTable buildAttrHashTable() {
+  AttrHashTable table{};
+  for (size_t slot = 0; slot < kAttrHashSlots; ++slot) {
+    table.slots[slot] = AttrId::Unknown;
+  }
+  for (size_t id = 0; id < kNumAttrIds; ++id) {
+    table.slots[attrHash(kAttrNames[id], kAttrHashSeed)] =
+        static_cast<AttrId>(id);
+  }
+  return table;
+}
+
+inline constexpr AttrHashTable kAttrHashTable = buildAttrHashTable();
+
+// Returns AttrId::Unknown for names outside the table
+constexpr AttrId lookupAttrId(std::string_view name) {
+  AttrId id = kAttrHashTable.slots[attrHash(name, kAttrHashSeed)];
+  if ((id != AttrId::Unknown) &&
+      (kAttrNames[static_cast<size_t>(id)] == name)) {
+    return id;
+  }
+  return AttrId::Unknown;
+}
+
+static_assert(lookupAttrId("comm_size") == AttrId::comm_size, "");
+static_assert(lookupAttrId("not_an_attr") == AttrId::Unknown, "");
+
+// Reads the member of the AttributeProto value oneof that matches T. The
+// member is picked at compile time, so T has to match the type the
+// attribute was written with (comm_size, for example, is an int64).
+template <typename T>
+struct AttrValue;
+
+#define CHAKRA_ATTR_VALUE(T, member)                               \
+  template <>                                                      \
+  struct AttrValue<T> {                                            \
+    using type = T;                                                \
+    static type get(const ChakraProtoMsg::AttributeProto& attr) { \
+      return attr.member();                                        \
+    }                                                              \
+  };
+
+CHAKRA_ATTR_VALUE(bool, bool_val)
+CHAKRA_ATTR_VALUE(int32_t, int32_val)
+CHAKRA_ATTR_VALUE(int64_t, int64_val)
+CHAKRA_ATTR_VALUE(uint32_t, uint32_val)
+CHAKRA_ATTR_VALUE(uint64_t, uint64_val)
+CHAKRA_ATTR_VALUE(float, float_val)
+CHAKRA_ATTR_VALUE(double, double_val)
+#undef CHAKRA_ATTR_VALUE
+
+template <>
+struct AttrValue<std::string> {
+  using type = const std::string&;
+  static type get(const ChakraProtoMsg::AttributeProto& attr) {
+    return attr.string_val();
+  }
+};
+
+} // namespace Chakra
@@ -0,0 +1,184 @@
+#include "et_converter.h"
+
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "et_def.pb.h"
+#include "et_feeder.h"
+#include "json_node_table.h"
+#include "json_trace_reader.h"
+#include "protoio.hh"
+
+using namespace std;
+
+namespace Chakra {
+
+namespace {
+ChakraProtoMsg::AttributeProto* addAttr(
+    ChakraProtoMsg::Node& node,
+    const char* name) {
+  ChakraProtoMsg::AttributeProto* attr = node.add_attr();
+  attr->set_name(name);
+  return attr;
+}
+
+// Sets the message of a node from its row in the table, with the attribute
+// types ETFeederNode reads them with
+void setNode(
+    const JSONNodeTable& table,
+    uint32_t row,
+    ChakraProtoMsg::Node& node) {
+  node.Clear();
+  node.set_id(table.id(row));
+  node.set_name(table.name(row));
+  node.set_type(static_cast<ChakraProtoMsg::NodeType>(table.type(row)));
+  node.set_duration_micros(table.runtime(row));
+  for (const uint64_t* dep = table.dataDepsBegin(row);
+       dep != table.dataDepsEnd(row);
+       ++dep) {
+    node.add_data_deps(*dep);
+  }
+  addAttr(node, "is_cpu_op")->set_bool_val(table.isCPUOp(row));
+  if (table.numOps(row) != 0) {
+    addAttr(node, "num_ops")->set_int64_val(table.numOps(row));
+  }
+  if (table.tensorSize(row) != 0) {
+    addAttr(node, "tensor_size")->set_uint64_val(table.tensorSize(row));
+  }
+  if (table.commType(row) != 0) {
+    addAttr(node, "comm_type")->set_int64_val(table.commType(row));
+  }
+  if (table.commPriority(row) != 0) {
+    addAttr(node, "comm_priority")->set_int32_val(table.commPriority(row));
+  }
+  if (table.commSize(row) != 0) {
+    addAttr(node, "comm_size")->set_int64_val(table.commSize(row));
+  }
+  if (table.commSrc(row) != 0) {
+    addAttr(node, "comm_src")->set_int32_val(table.commSrc(row));
+  }
+  if (table.commDst(row) != 0) {
+    addAttr(node, "comm_dst")->set_int32_val(table.commDst(row));
+  }
+  if (table.commTag(row) != 0) {
+    addAttr(node, "comm_tag")->set_int32_val(table.commTag(row));
+  }
+}
+} // namespace
+
+uint64_t convertJSONTrace(
+    const string& json_filename,
+    const string& et_filename) {
+  JSONTraceReader reader(json_filename);
+  if (!reader.is_open()) {
+    throw runtime_error("Failed to open JSON trace file: " + json_filename);
+  }
+  ProtoOutputStream output(et_filename);
+
+  ChakraProtoMsg::GlobalMetadata metadata;
+  metadata.set_version(kChakraSchemaVersion);
+  output.write(metadata);
+  // The table only ever holds the node being converted, in a row reused
+  // from one node to the next
+  JSONNodeTable table;
+  nlohmann::json data;
+  ChakraProtoMsg::Node node;
+  uint64_t num_nodes = 0;
+  while (reader.next(data)) {
+    const uint32_t row = table.append(data);
+    setNode(table, row, node);
+    table.releaseRow(row);
+    output.write(node);
+    ++num_nodes;
+  }
+  return num_nodes;
+}
+
+uint64_t reencodeTrace(
+    const string& trace_filename,
+    const string& output_filename,
+    TraceOrder order) {
+  ProtoInputStream trace(trace_filename);
+  if (!trace.is_open()) {
+    throw runtime_error("Failed to open trace file: " + trace_filename);
+  }
+  ProtoOutputStream output(output_filename);
+
+  ChakraProtoMsg::GlobalMetadata metadata;
+  trace.read(metadata);
+  output.write(metadata);
+  string record;
+  if (order == TraceOrder::Input) {
+    uint64_t num_nodes = 0;
+    while (trace.readRecord(record)) {
+      output.writeRecord(record);
+      ++num_nodes;
+    }
+    return num_nodes;
+  }
+
+  // Dependencies are kept as IDs until every node has a position
+  vector<string> records;
+  unordered_map<uint64_t, uint32_t> positions;
+  vector<uint64_t> dep_offsets = {0};
+  vector<uint64_t> dep_ids;
+  ChakraProtoMsg::Node node;
+  while (trace.readRecord(record)) {
+    if (!node.ParseFromString(record)) {
+      throw runtime_error("Malformed node in trace file: " + trace_filename);
+    }
+    positions.emplace(node.id(), records.size());
+    records.push_back(move(record));
+    dep_ids.insert(
+        dep_ids.end(), node.data_deps().begin(), node.data_deps().end());
+    dep_offsets.push_back(dep_ids.size());
+  }
+  const uint32_t num_nodes = static_cast<uint32_t>(records.size());
+
+  // Children of every node; dependencies on nodes missing from the trace
+  // are dropped
+  vector<vector<uint32_t>> children(num_nodes);
+  vector<uint32_t> num_waiting(num_nodes, 0);
+  for (uint32_t child = 0; child < num_nodes; ++child) {
+    for (uint64_t i = dep_offsets[child]; i < dep_offsets[child + 1]; ++i) {
+      auto parent = positions.find(dep_ids[i]);
+      if (parent != positions.end()) {
+        children[parent->second].push_back(child);
+        ++num_waiting[child];
+      }
+    }
+  }
+  vector<uint64_t>().swap(dep_ids);
+  vector<uint64_t>().swap(dep_offsets);
+
+  // Ready nodes are written in input order
+  priority_queue<uint32_t, vector<uint32_t>, greater<uint32_t>> ready;
+  for (uint32_t position = 0; position < num_nodes; ++position) {
+    if (num_waiting[position] == 0) {
+      ready.push(position);
+    }
+  }
+  uint32_t num_written = 0;
+  while (!ready.empty()) {
+    uint32_t position = ready.top();
+    ready.pop();
+    output.writeRecord(records[position]);
+    string().swap(records[position]);
+    ++num_written;
+    for (uint32_t child : children[position]) {
+      if (--num_waiting[child] == 0) {
+        ready.push(child);
+      }
+    }
+  }
+  if (num_written != num_nodes) {
+    throw runtime_error(
+        "Dependencies form a cycle in trace file: " + trace_filename);
+  }
+  return num_written;
+}
+
+} // namespace Chakra
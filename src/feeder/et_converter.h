@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Chakra {
+
+// Order of the nodes in a re-encoded trace
+enum class TraceOrder {
+  // As in the input trace
+  Input,
+  // Every node after the nodes it depends on, and otherwise as in the input
+  // trace, so that the feeder never waits on a node it has not read yet.
+  // The encoded nodes are held in memory until the order is known.
+  Topological,
+};
+
+// Writes traces in the protobuf format ETFeeder reads. The output is
+// compressed as its file name says (see ProtoOutputStream): .gz for gzip
+// and .zb for independently compressed blocks, which the feeder decompresses
+// in parallel.
+
+// Streams the workload graph of a JSON trace into a protobuf trace one node
+// at a time, with the fields WrapperNode reads: runtime becomes
+// duration_micros and the other fields attributes, left out when they are 0
+// as the feeder reads missing attributes as 0. Returns the number of nodes
+// written. Throws std::runtime_error if the JSON trace cannot be read.
+uint64_t convertJSONTrace(
+    const std::string& json_filename,
+    const std::string& et_filename);
+
+// Copies a protobuf trace in the given order. Nodes in the input order are
+// copied without being parsed. Returns the number of nodes written. Throws
+// std::runtime_error if the trace cannot be read or, for the topological
+// order, if its dependencies form a cycle.
+uint64_t reencodeTrace(
+    const std::string& trace_filename,
+    const std::string& output_filename,
+    TraceOrder order = TraceOrder::Input);
+
+} // namespace Chakra
@@ -0,0 +1,225 @@
+#include "et_critical_path.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "et_def.pb.h"
+#include "protoio.hh"
+
+using namespace std;
+using namespace Chakra;
+
+namespace {
+// Sets an int64 attribute, replacing the value left by an earlier pass
+void setInt64Attr(
+    ChakraProtoMsg::Node& node,
+    const string& name,
+    int64_t value) {
+  for (auto& attr : *node.mutable_attr()) {
+    if (attr.name() == name) {
+      attr.set_int64_val(value);
+      return;
+    }
+  }
+  ChakraProtoMsg::AttributeProto* attr = node.add_attr();
+  attr->set_name(name);
+  attr->set_int64_val(value);
+}
+} // namespace
+
+unique_ptr<CriticalPath> CriticalPath::build(const string& trace_filename) {
+  ProtoInputStream trace(trace_filename);
+  if (!trace.is_open()) {
+    throw runtime_error("Failed to open trace file: " + trace_filename);
+  }
+
+  auto path = make_unique<CriticalPath>();
+  // Dependencies are kept as IDs until every node has a position
+  vector<uint64_t> durations;
+  vector<uint64_t> dep_offsets = {0};
+  vector<uint64_t> dep_ids;
+  ChakraProtoMsg::GlobalMetadata metadata;
+  trace.read(metadata);
+  ChakraProtoMsg::Node node;
+  while (trace.read(node)) {
+    // Positions are 32-bit, and one past the last node must fit as well
+    if (path->ids_.size() + 1 >= numeric_limits<uint32_t>::max()) {
+      throw runtime_error("Trace has too many nodes: " + trace_filename);
+    }
+    path->ids_.push_back(node.id());
+    durations.push_back(node.duration_micros());
+    dep_ids.insert(
+        dep_ids.end(), node.data_deps().begin(), node.data_deps().end());
+    dep_offsets.push_back(dep_ids.size());
+  }
+
+  path->positions_.reserve(path->ids_.size());
+  for (size_t node_pos = 0; node_pos < path->ids_.size(); ++node_pos) {
+    path->positions_.emplace_back(
+        path->ids_[node_pos], static_cast<uint32_t>(node_pos));
+  }
+  sort(path->positions_.begin(), path->positions_.end());
+
+  // Dependencies on nodes missing from the trace are dropped
+  vector<uint64_t> parent_offsets = {0};
+  vector<uint32_t> parents;
+  parents.reserve(dep_ids.size());
+  for (size_t node_pos = 0; node_pos < path->ids_.size(); ++node_pos) {
+    for (uint64_t i = dep_offsets[node_pos]; i < dep_offsets[node_pos + 1];
+         ++i) {
+      uint32_t parent;
+      if (path->findPosition(dep_ids[i], parent)) {
+        parents.push_back(parent);
+      }
+    }
+    parent_offsets.push_back(parents.size());
+  }
+  vector<uint64_t>().swap(dep_ids);
+  vector<uint64_t>().swap(dep_offsets);
+
+  path->compute(durations, parent_offsets, parents);
+  return path;
+}
+
+void CriticalPath::compute(
+    const vector<uint64_t>& durations,
+    const vector<uint64_t>& parent_offsets,
+    const vector<uint32_t>& parents) {
+  const uint32_t num_nodes = static_cast<uint32_t>(ids_.size());
+
+  // Children of every node, laid out by a counting sort of the parent lists
+  vector<uint64_t> child_offsets(num_nodes + 1, 0);
+  for (uint32_t parent : parents) {
+    ++child_offsets[parent + 1];
+  }
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    child_offsets[i + 1] += child_offsets[i];
+  }
+  vector<uint32_t> children(parents.size());
+  vector<uint64_t> cursors(child_offsets.begin(), child_offsets.end() - 1);
+  for (uint32_t node = 0; node < num_nodes; ++node) {
+    for (uint64_t i = parent_offsets[node]; i < parent_offsets[node + 1]; ++i) {
+      children[cursors[parents[i]]++] = node;
+    }
+  }
+  vector<uint64_t>().swap(cursors);
+
+  // Topological order, parents before children
+  vector<uint32_t> num_waiting(num_nodes);
+  vector<uint32_t> order;
+  order.reserve(num_nodes);
+  for (uint32_t node = 0; node < num_nodes; ++node) {
+    num_waiting[node] =
+        static_cast<uint32_t>(parent_offsets[node + 1] - parent_offsets[node]);
+    if (num_waiting[node] == 0) {
+      order.push_back(node);
+    }
+  }
+  for (size_t i = 0; i < order.size(); ++i) {
+    uint32_t node = order[i];
+    for (uint64_t j = child_offsets[node]; j < child_offsets[node + 1]; ++j) {
+      if (--num_waiting[children[j]] == 0) {
+        order.push_back(children[j]);
+      }
+    }
+  }
+  if (order.size() != num_nodes) {
+    throw runtime_error("Node dependencies form a cycle");
+  }
+
+  // Earliest start of every node, then its bottom level
+  vector<uint64_t> top_levels(num_nodes, 0);
+  for (uint32_t node : order) {
+    uint64_t end = top_levels[node] + durations[node];
+    for (uint64_t j = child_offsets[node]; j < child_offsets[node + 1]; ++j) {
+      top_levels[children[j]] = max(top_levels[children[j]], end);
+    }
+  }
+  bottom_levels_.assign(num_nodes, 0);
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    uint32_t node = *it;
+    uint64_t longest = 0;
+    for (uint64_t j = child_offsets[node]; j < child_offsets[node + 1]; ++j) {
+      longest = max(longest, bottom_levels_[children[j]]);
+    }
+    bottom_levels_[node] = durations[node] + longest;
+    length_ = max(length_, bottom_levels_[node]);
+  }
+
+  slacks_.resize(num_nodes);
+  for (uint32_t node = 0; node < num_nodes; ++node) {
+    slacks_[node] = length_ - top_levels[node] - bottom_levels_[node];
+  }
+}
+
+uint64_t CriticalPath::length() const {
+  return length_;
+}
+
+size_t CriticalPath::size() const {
+  return ids_.size();
+}
+
+bool CriticalPath::find(
+    uint64_t node_id,
+    uint64_t& bottom_level,
+    uint64_t& slack) const {
+  uint32_t position;
+  if (!findPosition(node_id, position)) {
+    return false;
+  }
+  bottom_level = bottom_levels_[position];
+  slack = slacks_[position];
+  return true;
+}
+
+bool CriticalPath::findPosition(uint64_t node_id, uint32_t& position) const {
+  auto entry = lower_bound(
+      positions_.begin(), positions_.end(), make_pair(node_id, uint32_t{0}));
+  if (entry == positions_.end() || entry->first != node_id) {
+    return false;
+  }
+  position = entry->second;
+  return true;
+}
+
+void CriticalPath::annotate(
+    const string& trace_filename,
+    const string& output_filename) const {
+  ProtoInputStream trace(trace_filename);
+  if (!trace.is_open()) {
+    throw runtime_error("Failed to open trace file: " + trace_filename);
+  }
+  ProtoOutputStream output(output_filename);
+
+  ChakraProtoMsg::GlobalMetadata metadata;
+  trace.read(metadata);
+  output.write(metadata);
+  ChakraProtoMsg::Node node;
+  // Nodes come back in the order they were read in build
+  size_t position = 0;
+  while (trace.read(node)) {
+    if (position >= ids_.size() || ids_[position] != node.id()) {
+      throw runtime_error(
+          "Trace changed since its critical path was computed: " +
+          trace_filename);
+    }
+    setInt64Attr(node, "bottom_level", bottom_levels_[position]);
+    setInt64Attr(node, "slack", slacks_[position]);
+    output.write(node);
+    ++position;
+  }
+}
+
+void CriticalPath::writeSidecar(const string& filename) const {
+  ofstream file(filename, ios::out | ios::trunc);
+  if (!file.is_open()) {
+    throw runtime_error("Failed to open " + filename + " for writing");
+  }
+  file << "node_id,bottom_level,slack\n";
+  for (size_t i = 0; i < ids_.size(); ++i) {
+    file << ids_[i] << "," << bottom_levels_[i] << "," << slacks_[i] << "\n";
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Chakra {
+
+// Critical-path levels of every node in a trace, from duration_micros and
+// data_deps. The bottom level of a node is its duration plus the largest
+// bottom level of its children, i.e. the longest path from its start to the
+// end of the trace; its slack is how much it could be delayed without
+// delaying the end. Dependencies may refer to nodes later in the trace, so
+// the whole graph is held in memory: no node messages, but the IDs,
+// durations and dependencies of every node, which is O(N+E). Building peaks
+// near 80 bytes per node plus 12 per dependency, and the result keeps 40
+// bytes per node.
+class CriticalPath {
+ public:
+  // Reads the trace once and computes every node's levels. Throws if the
+  // dependencies form a cycle or the trace has 2^32 - 1 nodes or more.
+  static std::unique_ptr<CriticalPath> build(const std::string& trace_filename);
+
+  // Length of the critical path, the largest bottom level
+  uint64_t length() const;
+  size_t size() const;
+  // Returns false if the trace has no node with the given ID
+  bool find(uint64_t node_id, uint64_t& bottom_level, uint64_t& slack) const;
+
+  // Copies the trace, setting the bottom_level and slack attributes (int64)
+  // of every node
+  void annotate(
+      const std::string& trace_filename,
+      const std::string& output_filename) const;
+  // Writes "node_id,bottom_level,slack" lines in trace order
+  void writeSidecar(const std::string& filename) const;
+
+ private:
+  void compute(
+      const std::vector<uint64_t>& durations,
+      const std::vector<uint64_t>& parent_offsets,
+      const std::vector<uint32_t>& parents);
+  // Position of the first node with the given ID in trace order
+  bool findPosition(uint64_t node_id, uint32_t& position) const;
+
+  // Per node, in trace order
+  std::vector<uint64_t> ids_{};
+  std::vector<uint64_t> bottom_levels_{};
+  std::vector<uint64_t> slacks_{};
+  // (ID, position) of every node, sorted
+  std::vector<std::pair<uint64_t, uint32_t>> positions_{};
+  uint64_t length_{0};
+};
+
+} // namespace Chakra
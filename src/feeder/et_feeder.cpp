@@ -1,89 +1,670 @@
 #include "et_feeder.h"
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 
 using namespace std;
 using namespace Chakra;
 
-ETFeeder::ETFeeder(string filename)
-    : trace_(filename), window_size_(4096 * 256), et_complete_(false) {
+namespace {
+// "CKPT", then the version of the layout written by ETFeeder::checkpoint
+constexpr uint64_t kCheckpointMagic = 0x54504b43;
+constexpr uint64_t kCheckpointVersion = 1;
+
+// Size of a file, or -1 if it cannot be opened
+int64_t fileSize(const string& filename) {
+  ifstream file(filename, ios::in | ios::binary | ios::ate);
+  if (!file.is_open()) {
+    return -1;
+  }
+  return static_cast<int64_t>(file.tellg());
+}
+
+void putUint64(string& out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+void putBytes(string& out, const string& bytes) {
+  putUint64(out, bytes.size());
+  out += bytes;
+}
+
+uint64_t getUint64(const string& in, size_t& pos) {
+  if (in.size() - pos < 8) {
+    throw runtime_error("Truncated feeder checkpoint");
+  }
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i) {
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(in[pos + i]))
+        << (8 * i);
+  }
+  pos += 8;
+  return value;
+}
+
+string getBytes(const string& in, size_t& pos) {
+  uint64_t size = getUint64(in, pos);
+  if (in.size() - pos < size) {
+    throw runtime_error("Truncated feeder checkpoint");
+  }
+  string bytes = in.substr(pos, size);
+  pos += size;
+  return bytes;
+}
+} // namespace
+
+ETFeeder::ETFeeder(string filename, const ETFeederOptions& options)
+    : ETFeeder(filename, options, true) {}
+
+ETFeeder::ETFeeder(
+    string filename,
+    const ETFeederOptions& options,
+    bool read_first_window)
+    : options_(options),
+      filename_(filename),
+      trace_(filename, options.use_mmap),
+      window_size_(options.window_size),
+      et_complete_(false),
+      dep_free_node_queue_(options.issue_policy) {
   if (!trace_.is_open()) { // Assuming a method to check if file is open
     throw std::runtime_error("Failed to open trace file: " + filename);
   }
 
+  if (options_.use_arena) {
+    node_slab_ = make_shared<NodeSlab>();
+  }
+  if (options_.concurrent) {
+    concurrent_queue_ = make_unique<MPMCQueue<shared_ptr<ETFeederNode>>>(
+        options_.concurrent_queue_capacity);
+  }
+  if (options_.prefetch &&
+      (options_.prefetch_low_watermark >= options_.prefetch_high_watermark)) {
+    throw std::invalid_argument(
+        "Prefetch low watermark must be below the high watermark");
+  }
+  if (options_.decode_pool != nullptr) {
+    decode_pool_ = options_.decode_pool;
+  } else if (options_.num_decode_threads > 0) {
+    decode_pool_ = make_shared<ThreadPool>(options_.num_decode_threads);
+  }
+  if (options_.use_index) {
+    const string index_filename = options_.index_filename.empty()
+        ? ETIndex::defaultFilename(filename)
+        : options_.index_filename;
+    index_ = ETIndex::load(index_filename, filename);
+    if (index_ == nullptr && !options_.index_filename.empty()) {
+      cerr << "Ignoring index file " << index_filename
+           << ": missing or not built for " << filename << endl;
+    }
+  }
+
   try {
     readGlobalMetadata();
-    readNextWindow();
+    // A restored feeder first moves to where its checkpoint was taken
+    if (read_first_window) {
+      startPrefetch();
+      readNextWindow();
+    }
   } catch (const std::exception& e) {
     cerr << "Error in constructor: " << e.what() << endl;
+    stopPrefetch();
     throw; // Rethrow the exception for caller to handle
   }
 }
 
-ETFeeder::~ETFeeder() {}
+ETFeeder::~ETFeeder() {
+  stopPrefetch();
+  // Workers may still be parsing into the batch read ahead
+  if (pending_batch_ != nullptr) {
+    for (auto& task : pending_batch_->tasks) {
+      task.wait();
+    }
+  }
+  // Children blocks shared within a window would otherwise keep their
+  // parents alive
+  for (auto& entry : dep_graph_) {
+    entry.second->releaseChildren();
+  }
+}
+
+// Estimated memory of a decoded node: the node and its message, plus the
+// encoded size of the message's fields and one AttributeProto per attribute
+static uint64_t nodeFootprint(ETFeederNode& node) {
+  shared_ptr<ChakraProtoMsg::Node> pkt_msg = node.getChakraNode();
+  return sizeof(ETFeederNode) + sizeof(ChakraProtoMsg::Node) +
+      pkt_msg->ByteSizeLong() +
+      pkt_msg->attr_size() * sizeof(ChakraProtoMsg::AttributeProto);
+}
+
+void ETFeeder::startPrefetch() {
+  if (!options_.prefetch) {
+    return;
+  }
+  prefetch_queue_ = make_unique<SPSCQueue<shared_ptr<ETFeederNode>>>(
+      options_.prefetch_high_watermark);
+  prefetch_thread_ = thread(&ETFeeder::prefetchLoop, this);
+}
+
+void ETFeeder::checkpoint(const string& checkpoint_filename) {
+  if (options_.prefetch) {
+    throw logic_error("Feeder checkpoints are not supported in prefetch mode");
+  }
+  auto lock = lockGraph();
+  if (trace_.isSuspended() && !trace_.resume()) {
+    throw runtime_error("Failed to reopen trace file: " + filename_);
+  }
+
+  string out;
+  putUint64(out, kCheckpointMagic);
+  putUint64(out, kCheckpointVersion);
+  putBytes(out, filename_);
+  putUint64(out, static_cast<uint64_t>(fileSize(filename_)));
+  putUint64(out, nextNodeOffset());
+  putUint64(out, et_complete_);
+  putUint64(out, finished_node_bitmap_.size());
+  for (uint64_t word : finished_node_bitmap_) {
+    putUint64(out, word);
+  }
+  putUint64(out, finished_node_id_set_.size());
+  for (uint64_t node_id : finished_node_id_set_) {
+    putUint64(out, node_id);
+  }
+
+  // Each node with the links that cannot be told from its message
+  putUint64(out, dep_graph_.size());
+  for (const auto& entry : dep_graph_) {
+    const shared_ptr<ETFeederNode>& node = entry.second;
+    putBytes(out, node->getChakraNode()->SerializeAsString());
+    putUint64(out, node->getNumUnfinishedParents());
+    putUint64(out, node->childrenFreed());
+    vector<uint64_t> unresolved = node->getDepUnresolvedParentIDs();
+    putUint64(out, unresolved.size());
+    for (uint64_t parent_id : unresolved) {
+      putUint64(out, parent_id);
+    }
+    ChildSpan children = node->children();
+    putUint64(out, children.size());
+    for (const auto& child : children) {
+      putUint64(out, child->id());
+    }
+  }
+
+  ofstream file(checkpoint_filename, ios::out | ios::binary | ios::trunc);
+  file.write(out.data(), out.size());
+  if (!file.good()) {
+    throw runtime_error("Failed to write checkpoint " + checkpoint_filename);
+  }
+}
+
+unique_ptr<ETFeeder> ETFeeder::restore(
+    const string& checkpoint_filename,
+    const ETFeederOptions& options) {
+  ifstream file(checkpoint_filename, ios::in | ios::binary);
+  if (!file.is_open()) {
+    throw runtime_error("Failed to open checkpoint " + checkpoint_filename);
+  }
+  const string checkpoint(
+      (istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+  size_t pos = 0;
+  if (getUint64(checkpoint, pos) != kCheckpointMagic ||
+      getUint64(checkpoint, pos) != kCheckpointVersion) {
+    throw runtime_error("Not a feeder checkpoint: " + checkpoint_filename);
+  }
+  const string filename = getBytes(checkpoint, pos);
+  if (static_cast<int64_t>(getUint64(checkpoint, pos)) !=
+      fileSize(filename)) {
+    throw runtime_error("Trace changed since it was checkpointed: " + filename);
+  }
+  unique_ptr<ETFeeder> feeder(new ETFeeder(filename, options, false));
+  feeder->restoreState(checkpoint, pos);
+  return feeder;
+}
+
+void ETFeeder::restoreState(const string& checkpoint, size_t pos) {
+  const uint64_t offset = getUint64(checkpoint, pos);
+  et_complete_ = getUint64(checkpoint, pos) != 0;
+  finished_node_bitmap_.resize(getUint64(checkpoint, pos));
+  for (uint64_t& word : finished_node_bitmap_) {
+    word = getUint64(checkpoint, pos);
+  }
+  for (uint64_t i = getUint64(checkpoint, pos); i > 0; --i) {
+    finished_node_id_set_.emplace(getUint64(checkpoint, pos));
+  }
+
+  vector<pair<shared_ptr<ETFeederNode>, vector<uint64_t>>> children;
+  for (uint64_t i = getUint64(checkpoint, pos); i > 0; --i) {
+    shared_ptr<ChakraProtoMsg::Node> pkt_msg = newChakraNode();
+    if (!pkt_msg->ParseFromString(getBytes(checkpoint, pos))) {
+      throw runtime_error("Unable to parse node from feeder checkpoint");
+    }
+    shared_ptr<ETFeederNode> node = newFeederNode(pkt_msg);
+    for (uint64_t j = getUint64(checkpoint, pos); j > 0; --j) {
+      node->addUnfinishedParent();
+    }
+    if (getUint64(checkpoint, pos) != 0) {
+      node->markChildrenFreed();
+    }
+    for (uint64_t j = getUint64(checkpoint, pos); j > 0; --j) {
+      uint64_t parent_id = getUint64(checkpoint, pos);
+      node->addDepUnresolvedParentID(parent_id);
+      dep_unresolved_child_map_[parent_id].emplace_back(node);
+      dep_unresolved_node_set_.emplace(node);
+    }
+    vector<uint64_t> child_ids(getUint64(checkpoint, pos));
+    for (uint64_t& child_id : child_ids) {
+      child_id = getUint64(checkpoint, pos);
+    }
+    children.emplace_back(node, std::move(child_ids));
+    addNode(node);
+  }
+  for (const auto& entry : children) {
+    for (uint64_t child_id : entry.second) {
+      auto child = dep_graph_.find(child_id);
+      if (child != dep_graph_.end()) {
+        window_edges_.add(entry.first.get(), child->second.get());
+      }
+    }
+  }
+  window_edges_.link();
+
+  // The nodes that were issuable or in flight are issuable again
+  for (const auto& node : new_nodes_) {
+    if ((node->getNumUnfinishedParents() == 0) && !node->childrenFreed()) {
+      queueIssuableNode(node);
+    }
+  }
+  new_nodes_.clear();
+
+  if (!trace_.seek(offset)) {
+    throw runtime_error("Failed to seek in trace file: " + filename_);
+  }
+  // The part of the trace skipped over does not count as read
+  stats_file_bytes_ = trace_.fileByteCount();
+  stats_offset_ = trace_.tell();
+  startPrefetch();
+  refill();
+}
+
+uint64_t ETFeeder::nextNodeOffset() const {
+  if (decoded_index_ < decoded_nodes_.size()) {
+    return decoded_offsets_[decoded_index_];
+  }
+  if ((pending_batch_ != nullptr) && !pending_batch_->offsets.empty()) {
+    return pending_batch_->offsets.front();
+  }
+  return trace_.tell();
+}
+
+uint64_t ETFeeder::fastForward(
+    const function<bool(const ETFeederNode&)>& stop) {
+  uint64_t num_completed = 0;
+  shared_ptr<ETFeederNode> node;
+  while ((node = dequeueIssuableNode()) != nullptr) {
+    if (stop(*node)) {
+      queueIssuableNodeFront(std::move(node));
+      break;
+    }
+    auto entry = dep_graph_.find(node->id());
+    if (entry != dep_graph_.end()) {
+      freeChildren(entry->second);
+      eraseNode(entry);
+    }
+    ++num_completed;
+    refill();
+  }
+  return num_completed;
+}
+
+uint64_t ETFeeder::fastForward(uint64_t node_id) {
+  return fastForward(
+      [node_id](const ETFeederNode& node) { return node.id() == node_id; });
+}
 
 void ETFeeder::addNode(shared_ptr<ETFeederNode> node) {
+  if (options_.memory_budget_bytes > 0) {
+    graph_bytes_ += nodeFootprint(*node);
+    peak_graph_bytes_ = max(peak_graph_bytes_, graph_bytes_);
+  }
   dep_graph_[node->getChakraNode()->id()] = node;
+  new_nodes_.emplace_back(node);
 }
 
 void ETFeeder::removeNode(uint64_t node_id) {
-  dep_graph_.erase(node_id);
+  auto lock = lockGraph();
+  auto node = dep_graph_.find(node_id);
+  if (node != dep_graph_.end()) {
+    eraseNode(node);
+  }
+  refill();
+}
+
+void ETFeeder::eraseNode(
+    unordered_map<uint64_t, shared_ptr<ETFeederNode>>::iterator node) {
+  node->second->releaseChildren();
+  if (options_.memory_budget_bytes > 0) {
+    graph_bytes_ -= nodeFootprint(*node->second);
+    node->second->releaseMessage();
+  }
+  dep_graph_.erase(node);
+}
 
-  if (!et_complete_ && (dep_free_node_queue_.size() < window_size_)) {
-    readNextWindow();
+void ETFeeder::refill() {
+  if (et_complete_ || (numIssuableNodes() >= window_size_)) {
+    return;
+  }
+  // Over the budget, reading waits for nodes to be removed as long as there
+  // are issuable nodes to hand out meanwhile
+  if (overBudget() && (numIssuableNodes() != 0)) {
+    stallOnBudget();
+    return;
+  }
+  readNextWindow();
+}
+
+void ETFeeder::stallOnBudget() {
+  if (!budget_stalled_) {
+    budget_stalled_ = true;
+    ++num_budget_stalls_;
   }
 }
 
+size_t ETFeeder::getNextIssuableNodes(
+    vector<shared_ptr<ETFeederNode>>& nodes,
+    size_t max_nodes) {
+  size_t num_nodes = 0;
+  while (num_nodes < max_nodes) {
+    shared_ptr<ETFeederNode> node = dequeueIssuableNode();
+    if (node == nullptr) {
+      break;
+    }
+    nodes.emplace_back(std::move(node));
+    ++num_nodes;
+  }
+  return num_nodes;
+}
+
+void ETFeeder::retireNodes(const vector<uint64_t>& node_ids) {
+  auto lock = lockGraph();
+  for (uint64_t node_id : node_ids) {
+    auto node = dep_graph_.find(node_id);
+    if (node == dep_graph_.end()) {
+      continue;
+    }
+    freeChildren(node->second);
+    eraseNode(node);
+  }
+  refill();
+}
+
 bool ETFeeder::hasNodesToIssue() {
-  return !(dep_graph_.empty() && dep_free_node_queue_.empty());
+  auto lock = lockGraphShared();
+  return !(dep_graph_.empty() && (numIssuableNodes() == 0));
 }
 
 shared_ptr<ETFeederNode> ETFeeder::getNextIssuableNode() {
-  if (dep_free_node_queue_.size() != 0) {
-    shared_ptr<ETFeederNode> node = dep_free_node_queue_.top();
-    dep_free_node_id_set_.erase(node->getChakraNode()->id());
-    dep_free_node_queue_.pop();
+  return dequeueIssuableNode();
+}
+
+void ETFeeder::pushBackIssuableNode(uint64_t node_id) {
+  auto lock = lockGraphShared();
+  queueIssuableNode(dep_graph_.at(node_id));
+}
+
+void ETFeeder::queueIssuableNode(shared_ptr<ETFeederNode> node) {
+  if (concurrent_queue_ == nullptr) {
+    dep_free_node_id_set_.emplace(node->id());
+    dep_free_node_queue_.push(std::move(node));
+    return;
+  }
+  if (!concurrent_queue_->push(std::move(node))) {
+    // A failed push leaves the node in place
+    lock_guard<mutex> lock(overflow_mutex_);
+    overflow_nodes_.emplace_back(std::move(node));
+    ++num_overflow_nodes_;
+  }
+}
+
+void ETFeeder::queueIssuableNodeFront(shared_ptr<ETFeederNode> node) {
+  if (concurrent_queue_ == nullptr) {
+    dep_free_node_id_set_.emplace(node->id());
+    dep_free_node_queue_.pushFront(std::move(node));
+    return;
+  }
+  // The lock-free queue only pushes at its tail, so the nodes in it are
+  // queued again behind this one. No other thread may use the queue.
+  vector<shared_ptr<ETFeederNode>> queued;
+  queued.reserve(numIssuableNodes());
+  shared_ptr<ETFeederNode> queued_node;
+  while ((queued_node = dequeueIssuableNode()) != nullptr) {
+    queued.emplace_back(std::move(queued_node));
+  }
+  queueIssuableNode(std::move(node));
+  for (auto& entry : queued) {
+    queueIssuableNode(std::move(entry));
+  }
+}
+
+shared_ptr<ETFeederNode> ETFeeder::dequeueIssuableNode() {
+  if (concurrent_queue_ == nullptr) {
+    shared_ptr<ETFeederNode> node = dep_free_node_queue_.pop();
+    if (node != nullptr) {
+      dep_free_node_id_set_.erase(node->id());
+    }
     return node;
-  } else {
-    return nullptr;
   }
+  shared_ptr<ETFeederNode> node;
+  if (!concurrent_queue_->pop(node) && (num_overflow_nodes_ > 0)) {
+    lock_guard<mutex> lock(overflow_mutex_);
+    if (!overflow_nodes_.empty()) {
+      node = std::move(overflow_nodes_.front());
+      overflow_nodes_.pop_front();
+      --num_overflow_nodes_;
+    }
+  }
+  return node;
 }
 
-void ETFeeder::pushBackIssuableNode(uint64_t node_id) {
-  shared_ptr<ETFeederNode> node = dep_graph_[node_id];
-  dep_free_node_id_set_.emplace(node_id);
-  dep_free_node_queue_.emplace(node);
+unique_lock<shared_mutex> ETFeeder::lockGraph() const {
+  if (!options_.concurrent) {
+    return unique_lock<shared_mutex>();
+  }
+  return unique_lock<shared_mutex>(graph_mutex_);
+}
+
+shared_lock<shared_mutex> ETFeeder::lockGraphShared() const {
+  if (!options_.concurrent) {
+    return shared_lock<shared_mutex>();
+  }
+  return shared_lock<shared_mutex>(graph_mutex_);
 }
 
 shared_ptr<ETFeederNode> ETFeeder::lookupNode(uint64_t node_id) {
+  auto lock = lockGraphShared();
   try {
     return dep_graph_.at(node_id);
   } catch (const std::out_of_range& e) {
+    shared_ptr<ETFeederNode> node = fetchNode(node_id);
+    if (node != nullptr) {
+      return node;
+    }
     std::cerr << "looking for node_id=" << node_id
               << " in dep graph, however, not loaded yet" << std::endl;
     throw(e);
   }
 }
 
-void ETFeeder::freeChildrenNodes(uint64_t node_id) {
-  shared_ptr<ETFeederNode> node = dep_graph_[node_id];
-  for (auto child : node->getChildren()) {
-    auto child_chakra = child->getChakraNode();
-    for (auto it = child_chakra->mutable_data_deps()->begin();
-         it != child_chakra->mutable_data_deps()->end();
-         ++it) {
-      if (*it == node_id) {
-        child_chakra->mutable_data_deps()->erase(it);
-        break;
-      }
+shared_ptr<ETFeederNode> ETFeeder::fetchNode(uint64_t node_id) {
+  uint64_t offset;
+  lock_guard<mutex> lock(index_mutex_);
+  if (index_ == nullptr || !index_->find(node_id, offset)) {
+    return nullptr;
+  }
+  if (index_trace_ == nullptr) {
+    index_trace_ = make_unique<ProtoInputStream>(filename_, options_.use_mmap);
+  }
+  auto pkt_msg = make_shared<ChakraProtoMsg::Node>();
+  if (!index_trace_->seek(offset) || !index_trace_->read(*pkt_msg)) {
+    return nullptr;
+  }
+  return make_shared<ETFeederNode>(pkt_msg);
+}
+
+bool ETFeeder::hasIndex() const {
+  return index_ != nullptr;
+}
+
+void ETFeeder::suspend() {
+  auto lock = lockGraph();
+  if (options_.prefetch || trace_.isSuspended()) {
+    return;
+  }
+  // Workers may still be parsing from the mapping
+  if (pending_batch_ != nullptr) {
+    for (auto& task : pending_batch_->tasks) {
+      task.wait();
     }
-    if (child_chakra->data_deps().size() == 0) {
-      dep_free_node_id_set_.emplace(child_chakra->id());
-      dep_free_node_queue_.emplace(child);
+  }
+  trace_.suspend();
+  index_trace_.reset();
+}
+
+bool ETFeeder::isSuspended() const {
+  return trace_.isSuspended();
+}
+
+size_t ETFeeder::numIssuableNodes() const {
+  if (concurrent_queue_ != nullptr) {
+    return concurrent_queue_->size() + num_overflow_nodes_;
+  }
+  return dep_free_node_queue_.size();
+}
+
+uint64_t ETFeeder::graphBytes() const {
+  return graph_bytes_;
+}
+
+uint64_t ETFeeder::peakGraphBytes() const {
+  return peak_graph_bytes_;
+}
+
+uint64_t ETFeeder::numBudgetStalls() const {
+  return num_budget_stalls_;
+}
+
+uint64_t ETFeeder::numBudgetOverruns() const {
+  return num_budget_overruns_;
+}
+
+FeederStats ETFeeder::stats() const {
+  auto lock = lockGraphShared();
+  FeederStats stats = stats_;
+  stats.bytes_read = stats_bytes_read_.load(memory_order_relaxed);
+  stats.bytes_decompressed =
+      stats_bytes_decompressed_.load(memory_order_relaxed);
+  return stats;
+}
+
+void ETFeeder::recordWindow(
+    WindowSample& window,
+    chrono::steady_clock::time_point start) {
+  auto end = chrono::steady_clock::now();
+  window.start_ns = chrono::duration_cast<chrono::nanoseconds>(
+                        start - stats_start_)
+                        .count();
+  window.duration_ns =
+      chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+  window.num_graph_nodes = dep_graph_.size();
+  window.num_issuable_nodes = numIssuableNodes();
+  if (!options_.prefetch) {
+    countTraceBytes();
+  }
+  window.bytes_read = stats_bytes_read_.load(memory_order_relaxed);
+  window.bytes_decompressed =
+      stats_bytes_decompressed_.load(memory_order_relaxed);
+  stats_.addWindow(window);
+}
+
+void ETFeeder::countTraceBytes() {
+  const uint64_t file_bytes = trace_.fileByteCount();
+  const uint64_t offset = trace_.tell();
+  // The count of a compressed file starts over when its streams are
+  // recreated, which reads it again from the start
+  const uint64_t bytes_read = (file_bytes >= stats_file_bytes_)
+      ? file_bytes - stats_file_bytes_
+      : file_bytes;
+  const uint64_t bytes_decompressed =
+      (offset >= stats_offset_) ? offset - stats_offset_ : 0;
+  stats_file_bytes_ = file_bytes;
+  stats_offset_ = offset;
+  stats_bytes_read_.store(
+      stats_bytes_read_.load(memory_order_relaxed) + bytes_read,
+      memory_order_relaxed);
+  stats_bytes_decompressed_.store(
+      stats_bytes_decompressed_.load(memory_order_relaxed) +
+          bytes_decompressed,
+      memory_order_relaxed);
+}
+
+bool ETFeeder::overBudget() const {
+  return (options_.memory_budget_bytes > 0) &&
+      (graph_bytes_ >= options_.memory_budget_bytes);
+}
+
+void ETFeeder::freeChildrenNodes(uint64_t node_id) {
+  // The shared lock keeps the children from being relinked by a window read
+  // meanwhile, and marking the node finished from racing with that window
+  // reading its children
+  auto lock = lockGraphShared();
+  freeChildren(dep_graph_.at(node_id));
+}
+
+void ETFeeder::freeChildren(const shared_ptr<ETFeederNode>& node) {
+  if (!node->markChildrenFreed()) {
+    return;
+  }
+  if (options_.concurrent) {
+    lock_guard<mutex> finished_lock(finished_mutex_);
+    markNodeFinished(node->id());
+  } else {
+    markNodeFinished(node->id());
+  }
+  for (ETFeederNode* child : node->children()) {
+    if (child->removeUnfinishedParent() == 0) {
+      queueIssuableNode(child->shared_from_this());
     }
   }
 }
 
+// IDs below this bound are tracked in the bitmap
+static constexpr uint64_t kMaxBitmapNodeID = 1ull << 28;
+
+void ETFeeder::markNodeFinished(uint64_t node_id) {
+  if (node_id >= kMaxBitmapNodeID) {
+    finished_node_id_set_.emplace(node_id);
+    return;
+  }
+  size_t word = node_id / 64;
+  if (word >= finished_node_bitmap_.size()) {
+    finished_node_bitmap_.resize(
+        max(word + 1, finished_node_bitmap_.size() * 2), 0);
+  }
+  finished_node_bitmap_[word] |= 1ull << (node_id % 64);
+}
+
+bool ETFeeder::isNodeFinished(uint64_t node_id) const {
+  if (node_id >= kMaxBitmapNodeID) {
+    return finished_node_id_set_.count(node_id) != 0;
+  }
+  size_t word = node_id / 64;
+  return (word < finished_node_bitmap_.size()) &&
+      ((finished_node_bitmap_[word] >> (node_id % 64)) & 1);
+}
+
 void ETFeeder::readGlobalMetadata() {
   if (!trace_.is_open()) {
     throw runtime_error(
@@ -92,24 +673,238 @@ void ETFeeder::readGlobalMetadata() {
   shared_ptr<ChakraProtoMsg::GlobalMetadata> pkt_msg =
       make_shared<ChakraProtoMsg::GlobalMetadata>();
   trace_.read(*pkt_msg);
+  // Traces written before the version was recorded leave it empty
+  const string& version = pkt_msg->version();
+  if (!version.empty() && version != kChakraSchemaVersion) {
+    cerr << "Trace " << filename_ << " has schema version " << version
+         << ", expected " << kChakraSchemaVersion << endl;
+  }
+}
+
+shared_ptr<ChakraProtoMsg::Node> ETFeeder::newChakraNode() {
+  if (!options_.use_arena) {
+    return make_shared<ChakraProtoMsg::Node>();
+  }
+  // Start a new arena every window's worth of nodes. Each message shares
+  // ownership of its arena, which is freed along with the last of them.
+  if (arena_ == nullptr || arena_num_nodes_ >= window_size_) {
+    google::protobuf::ArenaOptions arena_options;
+    arena_options.start_block_size = 64 * 1024;
+    arena_options.max_block_size = 4 * 1024 * 1024;
+    arena_ = make_shared<google::protobuf::Arena>(arena_options);
+    arena_num_nodes_ = 0;
+  }
+  ++arena_num_nodes_;
+  return shared_ptr<ChakraProtoMsg::Node>(
+      arena_,
+      google::protobuf::Arena::Create<ChakraProtoMsg::Node>(arena_.get()));
+}
+
+shared_ptr<ETFeederNode> ETFeeder::newFeederNode(
+    shared_ptr<ChakraProtoMsg::Node> pkt_msg) {
+  if (!options_.use_arena) {
+    return make_shared<ETFeederNode>(pkt_msg);
+  }
+  return allocate_shared<ETFeederNode>(
+      NodeSlabAllocator<ETFeederNode>(node_slab_), pkt_msg);
+}
+
+shared_ptr<ETFeederNode> ETFeeder::decodeNode() {
+  if (decode_pool_ == nullptr) {
+    shared_ptr<ChakraProtoMsg::Node> pkt_msg = newChakraNode();
+    if (!trace_.read(*pkt_msg)) {
+      return nullptr;
+    }
+    return newFeederNode(pkt_msg);
+  }
+
+  if (decoded_index_ == decoded_nodes_.size()) {
+    if (pending_batch_ == nullptr) {
+      startDecodeBatch();
+    }
+    finishDecodeBatch();
+    // Read the next batch while this one is being consumed
+    startDecodeBatch();
+    if (decoded_nodes_.empty()) {
+      return nullptr;
+    }
+  }
+  return std::move(decoded_nodes_[decoded_index_++]);
+}
+
+void ETFeeder::startDecodeBatch() {
+  pending_batch_ = make_unique<DecodeBatch>();
+  DecodeBatch* batch = pending_batch_.get();
+  while (!decode_eof_ &&
+         (batch->messages.size() < options_.decode_batch_size)) {
+    uint64_t offset = trace_.tell();
+    if (trace_.isMapped()) {
+      // Parse straight from the mapped file
+      const char* data;
+      size_t size;
+      if (!trace_.readRecordView(data, size)) {
+        decode_eof_ = true;
+        break;
+      }
+      batch->views.emplace_back(data, size);
+    } else {
+      string record;
+      if (!trace_.readRecord(record)) {
+        decode_eof_ = true;
+        break;
+      }
+      batch->records.emplace_back(std::move(record));
+    }
+    batch->offsets.push_back(offset);
+    batch->messages.emplace_back(newChakraNode());
+  }
+  for (const auto& record : batch->records) {
+    batch->views.emplace_back(record.data(), record.size());
+  }
+
+  size_t num_records = batch->messages.size();
+  batch->nodes.resize(num_records);
+  size_t num_chunks = min(decode_pool_->size(), num_records);
+  for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+    size_t begin = num_records * chunk / num_chunks;
+    size_t end = num_records * (chunk + 1) / num_chunks;
+    batch->tasks.emplace_back(decode_pool_->submit([this, batch, begin, end] {
+      for (size_t i = begin; i < end; ++i) {
+        if (!batch->messages[i]->ParseFromArray(
+                batch->views[i].first,
+                static_cast<int>(batch->views[i].second))) {
+          throw runtime_error("Unable to parse node from trace");
+        }
+        batch->nodes[i] = newFeederNode(batch->messages[i]);
+      }
+    }));
+  }
+}
+
+void ETFeeder::finishDecodeBatch() {
+  // Wait for every chunk before reporting an error, as all of them refer to
+  // the batch
+  exception_ptr error = nullptr;
+  for (auto& task : pending_batch_->tasks) {
+    try {
+      task.get();
+    } catch (...) {
+      error = current_exception();
+    }
+  }
+  decoded_nodes_ = std::move(pending_batch_->nodes);
+  decoded_offsets_ = std::move(pending_batch_->offsets);
+  decoded_index_ = 0;
+  pending_batch_.reset();
+  if (error != nullptr) {
+    rethrow_exception(error);
+  }
+}
+
+void ETFeeder::prefetchLoop() {
+  try {
+    while (!prefetch_stop_) {
+      if (prefetch_queue_->size() >= options_.prefetch_high_watermark) {
+        unique_lock<mutex> lock(prefetch_mutex_);
+        prefetch_producer_waiting_ = true;
+        prefetch_producer_cv_.wait(lock, [this] {
+          return prefetch_stop_ ||
+              (prefetch_queue_->size() <= options_.prefetch_low_watermark);
+        });
+        prefetch_producer_waiting_ = false;
+        continue;
+      }
+      shared_ptr<ETFeederNode> node = decodeNode();
+      if (options_.collect_stats) {
+        countTraceBytes();
+      }
+      if (node == nullptr) {
+        break;
+      }
+      // Never full, as the queue holds up to the high watermark
+      prefetch_queue_->push(std::move(node));
+      if (prefetch_consumer_waiting_) {
+        lock_guard<mutex> lock(prefetch_mutex_);
+        prefetch_consumer_cv_.notify_one();
+      }
+    }
+  } catch (...) {
+    prefetch_error_ = current_exception();
+  }
+  {
+    lock_guard<mutex> lock(prefetch_mutex_);
+    prefetch_done_ = true;
+  }
+  prefetch_consumer_cv_.notify_one();
+}
+
+shared_ptr<ETFeederNode> ETFeeder::nextPrefetchedNode() {
+  shared_ptr<ETFeederNode> node;
+  if (!prefetch_queue_->pop(node)) {
+    unique_lock<mutex> lock(prefetch_mutex_);
+    prefetch_consumer_waiting_ = true;
+    prefetch_consumer_cv_.wait(lock, [this, &node] {
+      // The reader queues its last node before reporting that it is done
+      bool done = prefetch_done_;
+      return prefetch_queue_->pop(node) || done;
+    });
+    prefetch_consumer_waiting_ = false;
+  }
+  if (node == nullptr) {
+    if (prefetch_error_ != nullptr) {
+      rethrow_exception(prefetch_error_);
+    }
+    return nullptr;
+  }
+  if (prefetch_producer_waiting_ &&
+      (prefetch_queue_->size() <= options_.prefetch_low_watermark)) {
+    lock_guard<mutex> lock(prefetch_mutex_);
+    prefetch_producer_cv_.notify_one();
+  }
+  return node;
+}
+
+void ETFeeder::stopPrefetch() {
+  if (!prefetch_thread_.joinable()) {
+    return;
+  }
+  {
+    lock_guard<mutex> lock(prefetch_mutex_);
+    prefetch_stop_ = true;
+  }
+  prefetch_producer_cv_.notify_one();
+  prefetch_thread_.join();
 }
 
 shared_ptr<ETFeederNode> ETFeeder::readNode() {
-  shared_ptr<ChakraProtoMsg::Node> pkt_msg =
-      make_shared<ChakraProtoMsg::Node>();
-  if (!trace_.read(*pkt_msg)) {
+  shared_ptr<ETFeederNode> node =
+      options_.prefetch ? nextPrefetchedNode() : decodeNode();
+  if (node == nullptr) {
     return nullptr;
   }
-  shared_ptr<ETFeederNode> node = make_shared<ETFeederNode>(pkt_msg);
+  shared_ptr<ChakraProtoMsg::Node> pkt_msg = node->getChakraNode();
 
   bool dep_unresolved = false;
-  for (int i = 0; i < pkt_msg->data_deps_size(); ++i) {
-    auto parent_node = dep_graph_.find(pkt_msg->data_deps(i));
+  const auto& data_deps = pkt_msg->data_deps();
+  for (uint64_t dep : data_deps) {
+    // Parents that have already finished are not waited on, and a parent
+    // listed more than once is counted once
+    if (isNodeFinished(dep)) {
+      continue;
+    }
+    auto parent_node = dep_graph_.find(dep);
     if (parent_node != dep_graph_.end()) {
-      parent_node->second->addChild(node);
+      if (window_edges_.add(parent_node->second.get(), node.get())) {
+        node->addUnfinishedParent();
+      }
     } else {
-      dep_unresolved = true;
-      node->addDepUnresolvedParentID(pkt_msg->data_deps(i));
+      auto& waiting = dep_unresolved_child_map_[dep];
+      if (waiting.empty() || waiting.back() != node) {
+        dep_unresolved = true;
+        node->addUnfinishedParent();
+        node->addDepUnresolvedParentID(dep);
+        waiting.emplace_back(node);
+      }
     }
   }
 
@@ -121,38 +916,77 @@ shared_ptr<ETFeederNode> ETFeeder::readNode() {
 }
 
 void ETFeeder::resolveDep() {
-  for (auto it = dep_unresolved_node_set_.begin();
-       it != dep_unresolved_node_set_.end();) {
-    shared_ptr<ETFeederNode> node = *it;
-    vector<uint64_t> dep_unresolved_parent_ids =
-        node->getDepUnresolvedParentIDs();
-    for (auto inner_it = dep_unresolved_parent_ids.begin();
-         inner_it != dep_unresolved_parent_ids.end();) {
-      auto parent_node = dep_graph_.find(*inner_it);
-      if (parent_node != dep_graph_.end()) {
-        parent_node->second->addChild(node);
-        inner_it = dep_unresolved_parent_ids.erase(inner_it);
-      } else {
-        ++inner_it;
-      }
+  vector<shared_ptr<ETFeederNode>> parents;
+  for (const auto& parent_id_children : dep_unresolved_child_map_) {
+    auto parent_node = dep_graph_.find(parent_id_children.first);
+    if (parent_node != dep_graph_.end()) {
+      parents.emplace_back(parent_node->second);
     }
-    if (dep_unresolved_parent_ids.size() == 0) {
-      it = dep_unresolved_node_set_.erase(it);
-    } else {
-      node->setDepUnresolvedParentIDs(dep_unresolved_parent_ids);
-      ++it;
+  }
+  for (const auto& parent : parents) {
+    resolveDep(parent);
+  }
+  window_edges_.link();
+}
+
+// Links the nodes waiting on the given node, which has just been added to
+// the dependency graph
+void ETFeeder::resolveDep(shared_ptr<ETFeederNode> node) {
+  auto waiting = dep_unresolved_child_map_.find(node->id());
+  if (waiting == dep_unresolved_child_map_.end()) {
+    return;
+  }
+  for (const auto& child : waiting->second) {
+    window_edges_.add(node.get(), child.get());
+    if (child->removeDepUnresolvedParentID(node->id()) == 0) {
+      dep_unresolved_node_set_.erase(child);
     }
   }
+  dep_unresolved_child_map_.erase(waiting);
 }
 
 void ETFeeder::readNextWindow() {
-  if (!trace_.is_open()) {
+  if (trace_.isSuspended() && !trace_.resume()) {
+    throw runtime_error("Failed to reopen trace file: " + filename_);
+  }
+  // In prefetch mode the stream belongs to the prefetch thread
+  if (!options_.prefetch && !trace_.is_open()) {
     throw runtime_error(
         "Trace file closed unexpectedly during reading next window.");
   }
   uint32_t num_read = 0;
+  // Whether a node read in this window has no parent left to wait on
+  bool found_issuable = false;
+  bool overran_budget = false;
+  const bool collect_stats = options_.collect_stats;
+  WindowSample window;
+  chrono::steady_clock::time_point window_start;
+  chrono::steady_clock::time_point read_start;
+  if (collect_stats) {
+    window_start = chrono::steady_clock::now();
+  }
+  budget_stalled_ = false;
   do {
+    if (overBudget()) {
+      if (found_issuable || (numIssuableNodes() != 0)) {
+        stallOnBudget();
+        break;
+      }
+      overran_budget = true;
+    }
+    if (collect_stats) {
+      read_start = chrono::steady_clock::now();
+    }
     shared_ptr<ETFeederNode> new_node = readNode();
+    if (collect_stats) {
+      uint64_t read_ns = chrono::duration_cast<chrono::nanoseconds>(
+                             chrono::steady_clock::now() - read_start)
+                             .count();
+      window.read_ns += read_ns;
+      stats_.node_read_ns.add(read_ns);
+      window.peak_unresolved_nodes = max<uint64_t>(
+          window.peak_unresolved_nodes, dep_unresolved_node_set_.size());
+    }
     if (new_node == nullptr) {
       et_complete_ = true;
       break;
@@ -160,17 +994,30 @@ void ETFeeder::readNextWindow() {
 
     addNode(new_node);
     ++num_read;
+    found_issuable |= new_node->getNumUnfinishedParents() == 0;
 
-    resolveDep();
+    resolveDep(new_node);
   } while ((num_read < window_size_) || (dep_unresolved_node_set_.size() != 0));
+  window_edges_.link();
+  if (overran_budget) {
+    ++num_budget_overruns_;
+  }
 
-  for (auto node_id_node : dep_graph_) {
-    uint64_t node_id = node_id_node.first;
-    shared_ptr<ETFeederNode> node = node_id_node.second;
-    if ((dep_free_node_id_set_.count(node_id) == 0) &&
-        (node->getChakraNode()->data_deps().size() == 0)) {
-      dep_free_node_id_set_.emplace(node_id);
-      dep_free_node_queue_.emplace(node);
+  // Only nodes added since the last window can have become dependency free
+  // here; the others were queued when their parents were freed. Scanning the
+  // whole graph would also requeue nodes that were issued but not yet removed.
+  for (const auto& node : new_nodes_) {
+    uint64_t node_id = node->id();
+    if ((dep_graph_.count(node_id) != 0) &&
+        (dep_free_node_id_set_.count(node_id) == 0) &&
+        (node->getNumUnfinishedParents() == 0)) {
+      queueIssuableNode(node);
     }
   }
+  new_nodes_.clear();
+
+  if (collect_stats) {
+    window.num_nodes = num_read;
+    recordWindow(window, window_start);
+  }
 }
\ No newline at end of file
@@ -1,56 +1,299 @@
 #pragma once
 
+#include <google/protobuf/arena.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
-#include <queue>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "et_feeder_node.h"
+#include "et_index.h"
+#include "feeder_stats.h"
+#include "mpmc_queue.h"
+#include "node_slab.h"
 #include "protoio.hh"
+#include "ready_queue.h"
+#include "spsc_queue.h"
+#include "thread_pool.h"
 
 namespace Chakra {
-struct CompareNodes : public std::binary_function<
-                          std::shared_ptr<ETFeederNode>,
-                          std::shared_ptr<ETFeederNode>,
-                          bool> {
-  bool operator()(
-      const std::shared_ptr<ETFeederNode> lhs,
-      const std::shared_ptr<ETFeederNode> rhs) const {
-    return lhs->getChakraNode()->id() > rhs->getChakraNode()->id();
-  }
+// Version of the Chakra schema the feeder reads. Traces written by the tools
+// carry it in their GlobalMetadata.
+constexpr char kChakraSchemaVersion[] = "0.0.4";
+
+struct ETFeederOptions {
+  // Minimum number of nodes read per window
+  uint32_t window_size = 4096 * 256;
+  // Allocate node messages on protobuf arenas and feeder nodes from a slab.
+  // An arena is released in bulk once every node allocated on it is gone.
+  bool use_arena = false;
+  // Decode nodes on a background thread ahead of the windows that need them.
+  // Once the reader has queued the high watermark of nodes, it sleeps until
+  // the feeder has drained them down to the low watermark.
+  bool prefetch = false;
+  uint32_t prefetch_low_watermark = 16 * 1024;
+  uint32_t prefetch_high_watermark = 64 * 1024;
+  // Parse nodes on a pool of worker threads. Records are read in batches of
+  // decode_batch_size, parsed in parallel and handed out in file order, while
+  // the next batch is read. decode_pool lets several feeders share one pool;
+  // otherwise the feeder creates its own with num_decode_threads threads.
+  uint32_t num_decode_threads = 0;
+  uint32_t decode_batch_size = 1024;
+  std::shared_ptr<ThreadPool> decode_pool = nullptr;
+  // Memory-map uncompressed traces and parse nodes from the mapped pages
+  bool use_mmap = true;
+  // Let lookupNode fetch nodes that have not been read yet through a sidecar
+  // index (see ETIndex). An empty index_filename means <trace>.etidx, which
+  // is only used if it exists and was built for this trace.
+  bool use_index = true;
+  std::string index_filename = "";
+  // Bound the memory taken by the nodes in the dependency graph, estimated
+  // from their decoded messages; 0 means no bound. A window stops early once
+  // the graph reaches the budget, as long as some node is issuable, and
+  // removed nodes release their messages, after which only their id() may be
+  // read. Without an issuable node the feeder reads past the budget until it
+  // finds one. Nodes queued by the prefetch thread are bounded by the
+  // prefetch watermarks instead.
+  uint64_t memory_budget_bytes = 0;
+  // Order in which issuable nodes are handed out
+  IssuePolicy issue_policy = IssuePolicy::IdOrder;
+  // Let several threads call getNextIssuableNode(s), pushBackIssuableNode,
+  // freeChildrenNodes, removeNode and retireNodes at once. Issuable nodes go
+  // through a lock-free queue of concurrent_queue_capacity nodes, spilling
+  // into a locked one beyond it, and are handed out roughly in the order
+  // they became issuable whatever the issue policy. Children are freed in
+  // parallel under a shared lock of the graph, while removing a node, and
+  // reading the window that may follow, takes it exclusively.
+  bool concurrent = false;
+  uint32_t concurrent_queue_capacity = 64 * 1024;
+  // Time every window and node read, and keep the sizes of the graph and
+  // the issuable queue and the bytes read from the trace after every
+  // window, for stats(). Without it the feeder only tests this flag.
+  bool collect_stats = false;
 };
 
 class ETFeeder {
  public:
-  ETFeeder(std::string filename);
+  ETFeeder(
+      std::string filename,
+      const ETFeederOptions& options = ETFeederOptions());
   ~ETFeeder();
 
+  // Saves the state of the feeder: where it is in the trace, the nodes in
+  // the dependency graph and their links, and the nodes already finished.
+  // No other call may be in progress, and prefetch mode is not supported as
+  // the prefetch thread reads ahead of the windows.
+  void checkpoint(const std::string& checkpoint_filename);
+  // Creates a feeder over the trace a checkpoint was taken of, in the state
+  // it was saved in. Nodes issued but not completed at the time of the
+  // checkpoint are issuable again. Throws if the checkpoint is malformed or
+  // the trace has changed size since.
+  static std::unique_ptr<ETFeeder> restore(
+      const std::string& checkpoint_filename,
+      const ETFeederOptions& options = ETFeederOptions());
+  // Completes issuable nodes in issue order, without handing them out,
+  // until the next node to issue is one stop returns true for, returning
+  // how many nodes were completed. For example, stopping at the first node
+  // named "ProfilerStep#3" skips to the third iteration of a PyTorch trace.
+  // Not synchronized, even in concurrent mode.
+  uint64_t fastForward(const std::function<bool(const ETFeederNode&)>& stop);
+  uint64_t fastForward(uint64_t node_id);
+
   void addNode(std::shared_ptr<ETFeederNode> node);
+  // Removes the node from the graph and releases its children
   void removeNode(uint64_t node_id);
   bool hasNodesToIssue();
   std::shared_ptr<ETFeederNode> getNextIssuableNode();
+  // Appends up to max_nodes issuable nodes to nodes, returning how many
+  size_t getNextIssuableNodes(
+      std::vector<std::shared_ptr<ETFeederNode>>& nodes,
+      size_t max_nodes);
+  // Completes the given nodes: frees their children and removes them, with
+  // one graph lookup per node and at most one window read for the batch
+  void retireNodes(const std::vector<uint64_t>& node_ids);
   void pushBackIssuableNode(uint64_t node_id);
   std::shared_ptr<ETFeederNode> lookupNode(uint64_t node_id);
+  // Decodes a node straight from its offset in the trace, or returns nullptr
+  // without an index entry for it. The node is a detached copy: it is not
+  // added to the dependency graph and has no parents or children linked.
+  std::shared_ptr<ETFeederNode> fetchNode(uint64_t node_id);
+  bool hasIndex() const;
+  // Closes the trace until the next window is read, which reopens it where
+  // it left off, so that many feeders can share a budget of open files. Has
+  // no effect in prefetch mode, where the prefetch thread owns the trace.
+  void suspend();
+  bool isSuspended() const;
+  size_t numIssuableNodes() const;
+  // Memory accounting of the budget mode: the estimated bytes of the nodes in
+  // the graph now and at most, the number of times reading was held back by
+  // the budget, counted once until the next window is read, and the number
+  // of windows read past it for lack of an issuable node
+  uint64_t graphBytes() const;
+  uint64_t peakGraphBytes() const;
+  uint64_t numBudgetStalls() const;
+  uint64_t numBudgetOverruns() const;
+  // Telemetry collected so far, empty unless collect_stats is set. Call
+  // writeChromeTrace on it to see the windows on a timeline.
+  FeederStats stats() const;
   void freeChildrenNodes(uint64_t node_id);
   void readGlobalMetadata();
   std::shared_ptr<ETFeederNode> readNode();
+  // Not synchronized, even in concurrent mode
   void readNextWindow();
   void resolveDep();
 
  private:
+  // Records being parsed on the decode pool
+  struct DecodeBatch {
+    // Records copied out of a stream that is not memory-mapped
+    std::vector<std::string> records{};
+    std::vector<std::pair<const char*, size_t>> views{};
+    std::vector<std::shared_ptr<ChakraProtoMsg::Node>> messages{};
+    std::vector<std::shared_ptr<ETFeederNode>> nodes{};
+    // Offset of each record in the trace
+    std::vector<uint64_t> offsets{};
+    std::vector<std::future<void>> tasks{};
+  };
+
+  ETFeeder(
+      std::string filename,
+      const ETFeederOptions& options,
+      bool read_first_window);
+  void startPrefetch();
+  // Offset in the trace of the first node that has not been handed to a
+  // window, which may be behind the stream when decoding in batches
+  uint64_t nextNodeOffset() const;
+  void restoreState(const std::string& checkpoint, size_t pos);
+
+  void resolveDep(std::shared_ptr<ETFeederNode> node);
+  void freeChildren(const std::shared_ptr<ETFeederNode>& node);
+  void eraseNode(
+      std::unordered_map<uint64_t, std::shared_ptr<ETFeederNode>>::iterator
+          node);
+  // Reads the next window if the issuable nodes run low
+  void refill();
+  void queueIssuableNode(std::shared_ptr<ETFeederNode> node);
+  // Puts a dequeued node back so that it is handed out next
+  void queueIssuableNodeFront(std::shared_ptr<ETFeederNode> node);
+  std::shared_ptr<ETFeederNode> dequeueIssuableNode();
+  // Lock the graph in concurrent mode, and do nothing otherwise
+  std::unique_lock<std::shared_mutex> lockGraph() const;
+  std::shared_lock<std::shared_mutex> lockGraphShared() const;
+  std::shared_ptr<ETFeederNode> decodeNode();
+  void startDecodeBatch();
+  void finishDecodeBatch();
+  void prefetchLoop();
+  std::shared_ptr<ETFeederNode> nextPrefetchedNode();
+  void stopPrefetch();
+  bool overBudget() const;
+  // Counts a stall, unless reading is already held back by the budget
+  void stallOnBudget();
+  void recordWindow(
+      WindowSample& window,
+      std::chrono::steady_clock::time_point start);
+  // Adds the bytes read from the trace since the last call to the stats,
+  // from the thread that reads trace_
+  void countTraceBytes();
+  void markNodeFinished(uint64_t node_id);
+  bool isNodeFinished(uint64_t node_id) const;
+
+  std::shared_ptr<ChakraProtoMsg::Node> newChakraNode();
+  std::shared_ptr<ETFeederNode> newFeederNode(
+      std::shared_ptr<ChakraProtoMsg::Node> pkt_msg);
+
+  const ETFeederOptions options_;
+  const std::string filename_;
   ProtoInputStream trace_;
   const uint32_t window_size_;
   bool et_complete_;
 
+  // Arena the next node messages are allocated on, and the number of node
+  // messages allocated on it so far
+  std::shared_ptr<google::protobuf::Arena> arena_{nullptr};
+  uint32_t arena_num_nodes_{0};
+  std::shared_ptr<NodeSlab> node_slab_{nullptr};
+
+  // Sidecar index, and a second stream over the trace that fetchNode seeks
+  // around in so that the windowed reading is left undisturbed
+  std::unique_ptr<ETIndex> index_{nullptr};
+  std::unique_ptr<ProtoInputStream> index_trace_{nullptr};
+
   std::unordered_map<uint64_t, std::shared_ptr<ETFeederNode>> dep_graph_{};
+  // Budget mode accounting, see ETFeederOptions::memory_budget_bytes
+  uint64_t graph_bytes_{0};
+  uint64_t peak_graph_bytes_{0};
+  uint64_t num_budget_stalls_{0};
+  // Whether reading has been held back since the last window was read
+  bool budget_stalled_{false};
+  uint64_t num_budget_overruns_{0};
+  // Telemetry, see ETFeederOptions::collect_stats. Byte counts are updated
+  // by the prefetch thread in prefetch mode.
+  FeederStats stats_{};
+  const std::chrono::steady_clock::time_point stats_start_{
+      std::chrono::steady_clock::now()};
+  std::atomic<uint64_t> stats_bytes_read_{0};
+  std::atomic<uint64_t> stats_bytes_decompressed_{0};
+  uint64_t stats_file_bytes_{0};
+  uint64_t stats_offset_{0};
   std::unordered_set<uint64_t> dep_free_node_id_set_{};
-  std::priority_queue<
-      std::shared_ptr<ETFeederNode>,
-      std::vector<std::shared_ptr<ETFeederNode>>,
-      CompareNodes>
-      dep_free_node_queue_{};
+  ReadyQueue dep_free_node_queue_;
+  // Concurrent mode replaces dep_free_node_queue_ and dep_free_node_id_set_
+  // with a lock-free queue, and the nodes that did not fit in it
+  std::unique_ptr<MPMCQueue<std::shared_ptr<ETFeederNode>>> concurrent_queue_{
+      nullptr};
+  std::mutex overflow_mutex_{};
+  std::deque<std::shared_ptr<ETFeederNode>> overflow_nodes_{};
+  std::atomic<size_t> num_overflow_nodes_{0};
+  mutable std::shared_mutex graph_mutex_{};
+  // Serializes markNodeFinished between threads freeing children, and the
+  // use of index_trace_ between threads looking nodes up
+  std::mutex finished_mutex_{};
+  std::mutex index_mutex_{};
   std::unordered_set<std::shared_ptr<ETFeederNode>> dep_unresolved_node_set_{};
+  // Reverse index from a parent node ID that has not been read yet to the
+  // nodes waiting on it, so that reading a node only visits its own waiters
+  std::unordered_map<uint64_t, std::vector<std::shared_ptr<ETFeederNode>>>
+      dep_unresolved_child_map_{};
+  // Nodes added since the last window was read
+  std::vector<std::shared_ptr<ETFeederNode>> new_nodes_{};
+  // Edges created since the last window was read, linked at its end
+  WindowEdges window_edges_{};
+  // IDs of nodes whose children have been freed, so that a node read after
+  // its parent finished does not wait on it. Dense IDs are kept in a bitmap.
+  std::vector<uint64_t> finished_node_bitmap_{};
+  std::unordered_set<uint64_t> finished_node_id_set_{};
+
+  // Parallel decoding state, only used by the thread that reads trace_
+  std::shared_ptr<ThreadPool> decode_pool_{nullptr};
+  std::unique_ptr<DecodeBatch> pending_batch_{nullptr};
+  std::vector<std::shared_ptr<ETFeederNode>> decoded_nodes_{};
+  std::vector<uint64_t> decoded_offsets_{};
+  size_t decoded_index_{0};
+  bool decode_eof_{false};
+
+  // Nodes decoded by the prefetch thread, which owns trace_ in prefetch mode
+  std::unique_ptr<SPSCQueue<std::shared_ptr<ETFeederNode>>> prefetch_queue_{
+      nullptr};
+  std::thread prefetch_thread_{};
+  std::mutex prefetch_mutex_{};
+  std::condition_variable prefetch_producer_cv_{};
+  std::condition_variable prefetch_consumer_cv_{};
+  std::atomic<bool> prefetch_producer_waiting_{false};
+  std::atomic<bool> prefetch_consumer_waiting_{false};
+  std::atomic<bool> prefetch_done_{false};
+  std::atomic<bool> prefetch_stop_{false};
+  std::exception_ptr prefetch_error_{nullptr};
 };
 
 } // namespace Chakra
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "et_feeder_group.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace Chakra;
+
+ETFeederGroup::ETFeederGroup(
+    const vector<string>& filenames,
+    const ETFeederGroupOptions& options)
+    : max_open_traces_(max<uint32_t>(options.max_open_traces, 1)) {
+  ETFeederOptions feeder_options = options.feeder_options;
+  if (options.num_decode_threads > 0) {
+    decode_pool_ = make_shared<ThreadPool>(options.num_decode_threads);
+    feeder_options.decode_pool = decode_pool_;
+  }
+  if ((options.max_window_nodes > 0) && !filenames.empty()) {
+    uint64_t share = max<uint64_t>(
+        options.max_window_nodes / filenames.size(), 1);
+    feeder_options.window_size = static_cast<uint32_t>(
+        min<uint64_t>(share, feeder_options.window_size));
+  }
+
+  const uint32_t num_ranks = static_cast<uint32_t>(filenames.size());
+  feeders_.reserve(num_ranks);
+  open_rank_pos_.resize(num_ranks);
+  is_open_.assign(num_ranks, false);
+  is_ready_.assign(num_ranks, false);
+  // Each feeder reads its first window as it is created, so the budget is
+  // enforced one rank at a time rather than once all traces are open
+  for (uint32_t rank = 0; rank < num_ranks; ++rank) {
+    feeders_.emplace_back(
+        make_unique<ETFeeder>(filenames[rank], feeder_options));
+    touch(rank);
+    updateReady(rank);
+  }
+}
+
+ETFeederGroup::~ETFeederGroup() {
+  // Feeders wait on their batches in the shared pool, so they go first
+  feeders_.clear();
+}
+
+vector<string> ETFeederGroup::rankFilenames(
+    const string& prefix,
+    uint32_t num_ranks) {
+  vector<string> filenames;
+  filenames.reserve(num_ranks);
+  for (uint32_t rank = 0; rank < num_ranks; ++rank) {
+    filenames.emplace_back(prefix + "." + to_string(rank) + ".et");
+  }
+  return filenames;
+}
+
+uint32_t ETFeederGroup::numRanks() const {
+  return static_cast<uint32_t>(feeders_.size());
+}
+
+uint32_t ETFeederGroup::numOpenTraces() const {
+  return static_cast<uint32_t>(open_ranks_.size());
+}
+
+ETFeeder& ETFeederGroup::feeder(uint32_t rank) {
+  touch(rank);
+  return *feeders_.at(rank);
+}
+
+bool ETFeederGroup::hasNodesToIssue(uint32_t rank) {
+  return feeders_.at(rank)->hasNodesToIssue();
+}
+
+shared_ptr<ETFeederNode> ETFeederGroup::getNextIssuableNode(uint32_t rank) {
+  return feeders_.at(rank)->getNextIssuableNode();
+}
+
+shared_ptr<ETFeederNode> ETFeederGroup::getNextIssuableNodeAnyRank(
+    uint32_t& rank) {
+  // A queued rank may have been drained through the per-rank calls since
+  while (!ready_ranks_.empty()) {
+    uint32_t ready_rank = ready_ranks_.front();
+    ETFeeder& ready_feeder = *feeders_[ready_rank];
+    if (ready_feeder.numIssuableNodes() == 0) {
+      ready_ranks_.pop_front();
+      is_ready_[ready_rank] = false;
+      continue;
+    }
+    shared_ptr<ETFeederNode> node = ready_feeder.getNextIssuableNode();
+    if (ready_feeder.numIssuableNodes() == 0) {
+      ready_ranks_.pop_front();
+      is_ready_[ready_rank] = false;
+    }
+    rank = ready_rank;
+    return node;
+  }
+  return nullptr;
+}
+
+size_t ETFeederGroup::getNextIssuableNodes(
+    uint32_t rank,
+    vector<shared_ptr<ETFeederNode>>& nodes,
+    size_t max_nodes) {
+  return feeders_.at(rank)->getNextIssuableNodes(nodes, max_nodes);
+}
+
+void ETFeederGroup::retireNodes(
+    uint32_t rank,
+    const vector<uint64_t>& node_ids) {
+  // Retiring nodes may read the next window
+  touch(rank);
+  feeders_.at(rank)->retireNodes(node_ids);
+  updateReady(rank);
+}
+
+void ETFeederGroup::pushBackIssuableNode(uint32_t rank, uint64_t node_id) {
+  feeders_.at(rank)->pushBackIssuableNode(node_id);
+  updateReady(rank);
+}
+
+shared_ptr<ETFeederNode> ETFeederGroup::lookupNode(
+    uint32_t rank,
+    uint64_t node_id) {
+  // Falls back to the sidecar index, which reads the trace
+  touch(rank);
+  return feeders_.at(rank)->lookupNode(node_id);
+}
+
+void ETFeederGroup::freeChildrenNodes(uint32_t rank, uint64_t node_id) {
+  feeders_.at(rank)->freeChildrenNodes(node_id);
+  updateReady(rank);
+}
+
+void ETFeederGroup::removeNode(uint32_t rank, uint64_t node_id) {
+  // Removing a node may read the next window
+  touch(rank);
+  feeders_.at(rank)->removeNode(node_id);
+  updateReady(rank);
+}
+
+void ETFeederGroup::touch(uint32_t rank) {
+  if (rank >= feeders_.size()) {
+    throw out_of_range("No trace for rank " + to_string(rank));
+  }
+  if (is_open_[rank]) {
+    open_ranks_.splice(
+        open_ranks_.begin(), open_ranks_, open_rank_pos_[rank]);
+    return;
+  }
+  open_ranks_.push_front(rank);
+  open_rank_pos_[rank] = open_ranks_.begin();
+  is_open_[rank] = true;
+  while (open_ranks_.size() > max_open_traces_) {
+    uint32_t lru_rank = open_ranks_.back();
+    open_ranks_.pop_back();
+    is_open_[lru_rank] = false;
+    feeders_[lru_rank]->suspend();
+  }
+}
+
+void ETFeederGroup::updateReady(uint32_t rank) {
+  if (!is_ready_[rank] && (feeders_[rank]->numIssuableNodes() > 0)) {
+    ready_ranks_.push_back(rank);
+    is_ready_[rank] = true;
+  }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "et_feeder.h"
+#include "thread_pool.h"
+
+namespace Chakra {
+struct ETFeederGroupOptions {
+  // Options every rank's feeder is created with
+  ETFeederOptions feeder_options{};
+  // Maximum number of traces kept open at once. Beyond it the least recently
+  // used rank's trace is suspended, and reopened where it left off when the
+  // rank next reads a window.
+  uint32_t max_open_traces = 256;
+  // Threads of the decode pool shared by all ranks; 0 decodes inline
+  uint32_t num_decode_threads = 0;
+  // Nodes read per window across all ranks. Each rank's window is an even
+  // share of it, capped at feeder_options.window_size; 0 keeps the cap.
+  uint64_t max_window_nodes = 0;
+};
+
+// Feeds the traces of a set of ranks, one ETFeeder per rank, while sharing
+// what can be shared between them: a bounded number of open traces, a
+// decode pool and a node budget for the windows. Every call takes the rank
+// it applies to, and getNextIssuableNodeAnyRank hands out issuable nodes
+// of whichever rank has some.
+class ETFeederGroup {
+ public:
+  ETFeederGroup(
+      const std::vector<std::string>& filenames,
+      const ETFeederGroupOptions& options = ETFeederGroupOptions());
+  ~ETFeederGroup();
+
+  // <prefix>.0.et, <prefix>.1.et, ... as written by the converters
+  static std::vector<std::string> rankFilenames(
+      const std::string& prefix,
+      uint32_t num_ranks);
+
+  uint32_t numRanks() const;
+  uint32_t numOpenTraces() const;
+  // Direct access to a rank's feeder, counted as a use of its trace
+  ETFeeder& feeder(uint32_t rank);
+
+  bool hasNodesToIssue(uint32_t rank);
+  std::shared_ptr<ETFeederNode> getNextIssuableNode(uint32_t rank);
+  // Issuable node of any rank, or nullptr if no rank has one. Ranks are
+  // served in the order they became issuable.
+  std::shared_ptr<ETFeederNode> getNextIssuableNodeAnyRank(uint32_t& rank);
+  size_t getNextIssuableNodes(
+      uint32_t rank,
+      std::vector<std::shared_ptr<ETFeederNode>>& nodes,
+      size_t max_nodes);
+  void retireNodes(uint32_t rank, const std::vector<uint64_t>& node_ids);
+  void pushBackIssuableNode(uint32_t rank, uint64_t node_id);
+  std::shared_ptr<ETFeederNode> lookupNode(uint32_t rank, uint64_t node_id);
+  void freeChildrenNodes(uint32_t rank, uint64_t node_id);
+  void removeNode(uint32_t rank, uint64_t node_id);
+
+ private:
+  ETFeederGroup(const ETFeederGroup&) = delete;
+  ETFeederGroup& operator=(const ETFeederGroup&) = delete;
+
+  // Marks the rank's trace as the most recently used, suspending the least
+  // recently used ones that go over the budget
+  void touch(uint32_t rank);
+  // Queues the rank if it has issuable nodes and is not queued already
+  void updateReady(uint32_t rank);
+
+  const uint32_t max_open_traces_;
+  std::shared_ptr<ThreadPool> decode_pool_{nullptr};
+  std::vector<std::unique_ptr<ETFeeder>> feeders_{};
+
+  // Ranks whose trace is open, most recently used first
+  std::list<uint32_t> open_ranks_{};
+  std::vector<std::list<uint32_t>::iterator> open_rank_pos_{};
+  std::vector<bool> is_open_{};
+
+  // Ranks that may have issuable nodes, in the order they were queued
+  std::deque<uint32_t> ready_ranks_{};
+  std::vector<bool> is_ready_{};
+};
+
+} // namespace Chakra
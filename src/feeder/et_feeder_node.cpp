@@ -1,79 +1,184 @@
 #include "et_feeder_node.h"
 
+#include <algorithm>
+
 using namespace std;
 using namespace Chakra;
 
 ETFeederNode::ETFeederNode(std::shared_ptr<ChakraProtoMsg::Node> node) {
   this->node_ = node;
   this->id_ = node->id();
-  this->name_ = node->name();
-  this->runtime_ = node->duration_micros();
-  this->is_cpu_op_ = 0;
-
-  if (node->has_inputs()) {
-    this->inputs_values_ = static_cast<string>(node->inputs().values());
-    this->inputs_shapes_ = static_cast<string>(node->inputs().shapes());
-    this->inputs_types_ = static_cast<string>(node->inputs().types());
-  }
+}
 
-  if (node->has_outputs()) {
-    this->outputs_values_ = static_cast<string>(node->outputs().values());
-    this->outputs_shapes_ = static_cast<string>(node->outputs().shapes());
-    this->outputs_types_ = static_cast<string>(node->outputs().types());
-  }
+void ETFeederNode::decodeAttrs() const {
+  call_once(attrs_decoded_, &ETFeederNode::decodeAttrsOnce, this);
+}
 
-  for (const auto& attr : node->attr()) {
-    const string& attr_name = attr.name();
-
-    if (attr_name == "is_cpu_op") {
-      this->is_cpu_op_ = static_cast<bool>(attr.bool_val());
-    } else if (attr_name == "num_ops") {
-      this->num_ops_ = static_cast<uint64_t>(attr.int64_val());
-    } else if (attr_name == "tensor_size") {
-      this->tensor_size_ = attr.uint64_val();
-    } else if (attr_name == "comm_type") {
-      this->comm_type_ =
-          static_cast<ChakraProtoMsg::CollectiveCommType>(attr.int64_val());
-    } else if (attr_name == "comm_priority") {
-      this->comm_priority_ = static_cast<uint32_t>(attr.int32_val());
-    } else if (attr_name == "comm_size") {
-      this->comm_size_ = static_cast<uint64_t>(attr.int64_val());
-    } else if (attr_name == "comm_src") {
-      this->comm_src_ = static_cast<uint32_t>(attr.int32_val());
-    } else if (attr_name == "comm_dst") {
-      this->comm_dst_ = static_cast<uint32_t>(attr.int32_val());
-    } else if (attr_name == "comm_tag") {
-      this->comm_tag_ = static_cast<uint32_t>(attr.int32_val());
-    } else if (attr_name == "pg_name") {
-      this->pg_name_ = static_cast<string>(attr.string_val());
+void ETFeederNode::decodeAttrsOnce() const {
+  // Nothing to decode once the message has been released
+  if (node_ == nullptr) {
+    return;
+  }
+  for (const auto& attr : node_->attr()) {
+    AttrId id = lookupAttrId(attr.name());
+    if (id != AttrId::Unknown) {
+      this->known_attrs_[static_cast<size_t>(id)] = &attr;
     } else {
-      this->other_attrs_.emplace(attr_name, attr);
+      this->other_attrs_.emplace(attr.name(), attr);
     }
   }
 }
 
+const ChakraProtoMsg::AttributeProto* ETFeederNode::find_attr(
+    AttrId id) const {
+  decodeAttrs();
+  return known_attrs_[static_cast<size_t>(id)];
+}
+
+bool ETFeederNode::has_attr(AttrId id) const {
+  return find_attr(id) != nullptr;
+}
+
 shared_ptr<ChakraProtoMsg::Node> ETFeederNode::getChakraNode() {
   return node_;
 }
 
-void ETFeederNode::addChild(shared_ptr<ETFeederNode> node) {
+// Returns false if the node was already a child of this node
+bool ETFeederNode::addChild(shared_ptr<ETFeederNode> node) {
   // Avoid adding the same child node multiple times
-  // addChild is called multiple times to resolve dependencies
-  if (children_set_.find(node) != children_set_.end()) {
-    return;
+  for (const auto& child : children()) {
+    if (child == node.get()) {
+      return false;
+    }
   }
-  children_vec_.emplace_back(node);
-  children_set_.emplace(node);
+  WindowEdges edges;
+  edges.add(this, node.get());
+  edges.link();
+  return true;
 }
 
 vector<shared_ptr<ETFeederNode>> ETFeederNode::getChildren() {
-  return children_vec_;
+  vector<shared_ptr<ETFeederNode>> copy;
+  copy.reserve(num_children_);
+  for (ETFeederNode* child : children()) {
+    copy.emplace_back(child->shared_from_this());
+  }
+  return copy;
+}
+
+ChildSpan ETFeederNode::children() const {
+  if (child_block_ == nullptr) {
+    return ChildSpan();
+  }
+  return ChildSpan(child_block_->data() + children_offset_, num_children_);
+}
+
+void ETFeederNode::releaseChildren() {
+  child_block_ = nullptr;
+  children_offset_ = 0;
+  num_children_ = 0;
+}
+
+void ETFeederNode::releaseMessage() {
+  node_ = nullptr;
+  fill(begin(known_attrs_), end(known_attrs_), nullptr);
+  other_attrs_.clear();
+}
+
+bool WindowEdges::add(ETFeederNode* parent, ETFeederNode* child) {
+  for (auto it = edges_.rbegin();
+       (it != edges_.rend()) && (it->second == child);
+       ++it) {
+    if (it->first == parent) {
+      return false;
+    }
+  }
+  edges_.emplace_back(parent, child);
+  return true;
+}
+
+void WindowEdges::link() {
+  if (edges_.empty()) {
+    return;
+  }
+  for (const auto& edge : edges_) {
+    if (edge.first->num_new_children_++ == 0) {
+      parents_.emplace_back(edge.first);
+    }
+  }
+  size_t block_size = 0;
+  for (ETFeederNode* parent : parents_) {
+    block_size += parent->num_children_ + parent->num_new_children_;
+  }
+
+  // Give each parent its range of the block, starting with the children it
+  // already had; its offset and count then serve as the insertion cursor
+  auto block = make_shared<ChildBlock>(block_size);
+  size_t offset = 0;
+  for (ETFeederNode* parent : parents_) {
+    ChildSpan old_children = parent->children();
+    copy(old_children.begin(), old_children.end(), block->begin() + offset);
+    parent->children_offset_ = static_cast<uint32_t>(offset);
+    offset += parent->num_children_ + parent->num_new_children_;
+  }
+  for (const auto& edge : edges_) {
+    ETFeederNode* parent = edge.first;
+    (*block)[parent->children_offset_ + parent->num_children_++] = edge.second;
+  }
+  for (ETFeederNode* parent : parents_) {
+    parent->child_block_ = block;
+    parent->num_new_children_ = 0;
+  }
+
+  edges_.clear();
+  parents_.clear();
+}
+
+bool WindowEdges::empty() const {
+  return edges_.empty();
 }
 
 void ETFeederNode::addDepUnresolvedParentID(uint64_t node_id) {
   dep_unresolved_parent_ids_.emplace_back(node_id);
 }
 
+// Returns the number of parents that are still unresolved
+size_t ETFeederNode::removeDepUnresolvedParentID(uint64_t node_id) {
+  dep_unresolved_parent_ids_.erase(
+      remove(
+          dep_unresolved_parent_ids_.begin(),
+          dep_unresolved_parent_ids_.end(),
+          node_id),
+      dep_unresolved_parent_ids_.end());
+  return dep_unresolved_parent_ids_.size();
+}
+
+void ETFeederNode::addUnfinishedParent() {
+  ++num_unfinished_parents_;
+}
+
+// Returns the number of parents that have not finished yet
+uint32_t ETFeederNode::removeUnfinishedParent() {
+  uint32_t count = num_unfinished_parents_.load();
+  while ((count > 0) &&
+         !num_unfinished_parents_.compare_exchange_weak(count, count - 1)) {
+  }
+  return (count > 0) ? (count - 1) : 0;
+}
+
+uint32_t ETFeederNode::getNumUnfinishedParents() const {
+  return num_unfinished_parents_;
+}
+
+// Returns false if the children of this node have already been freed
+bool ETFeederNode::markChildrenFreed() {
+  return !children_freed_.exchange(true);
+}
+
+bool ETFeederNode::childrenFreed() const {
+  return children_freed_;
+}
+
 vector<uint64_t> ETFeederNode::getDepUnresolvedParentIDs() {
   return dep_unresolved_parent_ids_;
 }
@@ -85,6 +190,9 @@ void ETFeederNode::setDepUnresolvedParentIDs(
 
 const ChakraProtoMsg::AttributeProto& ETFeederNode::get_other_attr(
     const string& attr_name) const {
+  AttrId id = lookupAttrId(attr_name);
+  if (id != AttrId::Unknown && has_attr(id))
+    return *find_attr(id);
   if (this->has_other_attr(attr_name))
     return this->other_attrs_.at(attr_name);
   throw std::runtime_error(
@@ -93,108 +201,96 @@ const ChakraProtoMsg::AttributeProto& ETFeederNode::get_other_attr(
 }
 
 bool ETFeederNode::has_other_attr(const string& attr_name) const {
+  AttrId id = lookupAttrId(attr_name);
+  if (id != AttrId::Unknown)
+    return has_attr(id);
+  decodeAttrs();
   const auto& item = this->other_attrs_.find(attr_name);
   return item != this->other_attrs_.end();
 }
 
-uint64_t ETFeederNode::id() {
+uint64_t ETFeederNode::id() const {
   return id_;
 }
 
-string ETFeederNode::name() {
-  return name_;
+const string& ETFeederNode::name() const {
+  return node_->name();
 }
 
-bool ETFeederNode::is_cpu_op() {
-  return is_cpu_op_;
+bool ETFeederNode::is_cpu_op() const {
+  return get_attr<bool>(AttrId::is_cpu_op);
 }
 
-ChakraProtoMsg::NodeType ETFeederNode::type() {
+ChakraProtoMsg::NodeType ETFeederNode::type() const {
   return node_->type();
 }
 
-uint64_t ETFeederNode::runtime() {
-  return runtime_;
+uint64_t ETFeederNode::runtime() const {
+  return node_->duration_micros();
 }
 
-uint64_t ETFeederNode::num_ops() {
-  return num_ops_;
+uint64_t ETFeederNode::num_ops() const {
+  return static_cast<uint64_t>(get_attr<int64_t>(AttrId::num_ops));
 }
 
-uint32_t ETFeederNode::tensor_loc() {
-  return tensor_loc_;
+uint32_t ETFeederNode::tensor_loc() const {
+  return get_attr<uint32_t>(AttrId::tensor_loc);
 }
 
-uint64_t ETFeederNode::tensor_size() {
-  return tensor_size_;
+uint64_t ETFeederNode::tensor_size() const {
+  return get_attr<uint64_t>(AttrId::tensor_size);
 }
 
-ChakraProtoMsg::CollectiveCommType ETFeederNode::comm_type() {
-  return comm_type_;
+ChakraProtoMsg::CollectiveCommType ETFeederNode::comm_type() const {
+  return static_cast<ChakraProtoMsg::CollectiveCommType>(
+      get_attr<int64_t>(AttrId::comm_type));
 }
 
-uint32_t ETFeederNode::comm_priority() {
-  return comm_priority_;
+uint32_t ETFeederNode::comm_priority() const {
+  return static_cast<uint32_t>(get_attr<int32_t>(AttrId::comm_priority));
 }
 
-uint64_t ETFeederNode::comm_size() {
-  return comm_size_;
+uint64_t ETFeederNode::comm_size() const {
+  return static_cast<uint64_t>(get_attr<int64_t>(AttrId::comm_size));
 }
 
-uint32_t ETFeederNode::comm_src() {
-  return comm_src_;
+uint32_t ETFeederNode::comm_src() const {
+  return static_cast<uint32_t>(get_attr<int32_t>(AttrId::comm_src));
 }
 
-uint32_t ETFeederNode::comm_dst() {
-  return comm_dst_;
+uint32_t ETFeederNode::comm_dst() const {
+  return static_cast<uint32_t>(get_attr<int32_t>(AttrId::comm_dst));
 }
 
-uint32_t ETFeederNode::comm_tag() {
-  return comm_tag_;
+uint32_t ETFeederNode::comm_tag() const {
+  return static_cast<uint32_t>(get_attr<int32_t>(AttrId::comm_tag));
 }
 
-string ETFeederNode::pg_name() {
-  return pg_name_;
+const string& ETFeederNode::pg_name() const {
+  return get_attr<string>(AttrId::pg_name);
 }
 
-string ETFeederNode::get_inputs_values() const {
-  if (node_->has_inputs()) {
-    return inputs_values_;
-  }
-  return "";
+// A message without inputs or outputs hands out an empty default IOInfo
+const string& ETFeederNode::get_inputs_values() const {
+  return node_->inputs().values();
 }
 
-string ETFeederNode::get_inputs_shapes() const {
-  if (node_->has_inputs()) {
-    return inputs_shapes_;
-  }
-  return "";
+const string& ETFeederNode::get_inputs_shapes() const {
+  return node_->inputs().shapes();
 }
 
-string ETFeederNode::get_inputs_types() const {
-  if (node_->has_inputs()) {
-    return inputs_types_;
-  }
-  return "";
+const string& ETFeederNode::get_inputs_types() const {
+  return node_->inputs().types();
 }
 
-string ETFeederNode::get_outputs_values() const {
-  if (node_->has_outputs()) {
-    return outputs_values_;
-  }
-  return "";
+const string& ETFeederNode::get_outputs_values() const {
+  return node_->outputs().values();
 }
 
-string ETFeederNode::get_outputs_shapes() const {
-  if (node_->has_outputs()) {
-    return outputs_shapes_;
-  }
-  return "";
+const string& ETFeederNode::get_outputs_shapes() const {
+  return node_->outputs().shapes();
 }
 
-string ETFeederNode::get_outputs_types() const {
-  if (node_->has_outputs()) {
-    return outputs_types_;
-  }
-  return "";
+const string& ETFeederNode::get_outputs_types() const {
+  return node_->outputs().types();
 }
@@ -1,84 +1,173 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "et_attr.h"
 #include "et_def.pb.h"
 
 namespace Chakra {
 
-class ETFeederNode {
+class ETFeederNode;
+
+// Read-only view of a node's children, which are stored contiguously
+class ChildSpan {
+ public:
+  using iterator = ETFeederNode* const*;
+
+  ChildSpan() {}
+  ChildSpan(iterator begin, size_t size) : begin_(begin), size_(size) {}
+
+  iterator begin() const {
+    return begin_;
+  }
+  iterator end() const {
+    return begin_ + size_;
+  }
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+  ETFeederNode* operator[](size_t i) const {
+    return begin_[i];
+  }
+
+ private:
+  iterator begin_{nullptr};
+  size_t size_{0};
+};
+
+// Children of every parent linked in one window, parent after parent. The
+// children are owned by the feeder's dependency graph, so a block only holds
+// pointers and never keeps a node alive.
+using ChildBlock = std::vector<ETFeederNode*>;
+
+// Collects the edges created while a window is read, then lays them out in a
+// single compressed sparse row block: each parent's children end up in one
+// contiguous span of the block, which the parents linked in that window
+// share. The block is freed once all of them have released their children.
+class WindowEdges {
+ public:
+  // Returns false if the edge was already added. The edges to one child have
+  // to be added back to back for duplicates to be caught.
+  bool add(ETFeederNode* parent, ETFeederNode* child);
+  // Moves the added edges into a new block, after the children the parents
+  // already had, and points the parents at their spans
+  void link();
+  bool empty() const;
+
+ private:
+  std::vector<std::pair<ETFeederNode*, ETFeederNode*>> edges_{};
+  std::vector<ETFeederNode*> parents_{};
+};
+
+class ETFeederNode : public std::enable_shared_from_this<ETFeederNode> {
  public:
   ETFeederNode(std::shared_ptr<ChakraProtoMsg::Node> node);
   std::shared_ptr<ChakraProtoMsg::Node> getChakraNode();
-  void addChild(std::shared_ptr<ETFeederNode> node);
+  // Links a single child right away; the feeder links whole windows through
+  // WindowEdges instead. The node does not own the child, which the caller
+  // keeps alive as the feeder's graph does for the children it links.
+  bool addChild(std::shared_ptr<ETFeederNode> node);
+  // Copy of the children, prefer children() to iterate over them. Both are
+  // valid as long as the children are in the graph.
   std::vector<std::shared_ptr<ETFeederNode>> getChildren();
+  ChildSpan children() const;
+  // Drops the reference to the children, after which the node has none
+  void releaseChildren();
+  // Drops the reference to the node message, after which only id() may be
+  // read
+  void releaseMessage();
   void addDepUnresolvedParentID(uint64_t node_id);
+  size_t removeDepUnresolvedParentID(uint64_t node_id);
+  void addUnfinishedParent();
+  uint32_t removeUnfinishedParent();
+  uint32_t getNumUnfinishedParents() const;
+  bool markChildrenFreed();
+  bool childrenFreed() const;
   std::vector<uint64_t> getDepUnresolvedParentIDs();
   void setDepUnresolvedParentIDs(
       std::vector<uint64_t> const& dep_unresolved_parent_ids);
 
+  // Look up any attribute by name, known to AttrId or not
   const ChakraProtoMsg::AttributeProto& get_other_attr(
       const std::string& attr_name) const;
   bool has_other_attr(const std::string& attr_name) const;
 
-  uint64_t id();
-  std::string name();
-  bool is_cpu_op();
-  ChakraProtoMsg::NodeType type();
-  uint64_t runtime();
-  uint64_t num_ops();
-  uint32_t tensor_loc();
-  uint64_t tensor_size();
-  ChakraProtoMsg::CollectiveCommType comm_type();
-  uint32_t comm_priority();
-  uint64_t comm_size();
-  uint32_t comm_src();
-  uint32_t comm_dst();
-  uint32_t comm_tag();
-  std::string pg_name();
-  std::string get_inputs_values() const;
-  std::string get_inputs_shapes() const;
-  std::string get_inputs_types() const;
-  std::string get_outputs_values() const;
-  std::string get_outputs_shapes() const;
-  std::string get_outputs_types() const;
+  // Typed access to known attributes through their dense ID. T selects the
+  // value member to read (see AttrValue); a missing attribute reads as the
+  // member's default.
+  template <typename T>
+  typename AttrValue<T>::type get_attr(AttrId id) const {
+    const ChakraProtoMsg::AttributeProto* attr = find_attr(id);
+    return AttrValue<T>::get(
+        attr != nullptr ? *attr
+                        : ChakraProtoMsg::AttributeProto::default_instance());
+  }
+  bool has_attr(AttrId id) const;
+
+  // Strings are returned by reference into the node message and stay valid
+  // as long as the node does
+  uint64_t id() const;
+  const std::string& name() const;
+  bool is_cpu_op() const;
+  ChakraProtoMsg::NodeType type() const;
+  uint64_t runtime() const;
+  uint64_t num_ops() const;
+  uint32_t tensor_loc() const;
+  uint64_t tensor_size() const;
+  ChakraProtoMsg::CollectiveCommType comm_type() const;
+  uint32_t comm_priority() const;
+  uint64_t comm_size() const;
+  uint32_t comm_src() const;
+  uint32_t comm_dst() const;
+  uint32_t comm_tag() const;
+  const std::string& pg_name() const;
+  const std::string& get_inputs_values() const;
+  const std::string& get_inputs_shapes() const;
+  const std::string& get_inputs_types() const;
+  const std::string& get_outputs_values() const;
+  const std::string& get_outputs_shapes() const;
+  const std::string& get_outputs_types() const;
 
  private:
-  void assign_attr_val(
-      std::shared_ptr<ChakraProtoMsg::Node> node,
-      int i,
-      void* member);
+  // Walks the attributes of the message the first time one of them is asked
+  // for, as many simulators only read the type, runtime and comm fields
+  void decodeAttrs() const;
+  void decodeAttrsOnce() const;
+  const ChakraProtoMsg::AttributeProto* find_attr(AttrId id) const;
+
+  friend class WindowEdges;
 
   std::shared_ptr<ChakraProtoMsg::Node> node_{nullptr};
-  std::unordered_set<std::shared_ptr<ETFeederNode>> children_set_{};
-  std::vector<std::shared_ptr<ETFeederNode>> children_vec_{};
+  // Span of the block holding this node's children
+  std::shared_ptr<const ChildBlock> child_block_{nullptr};
+  uint32_t children_offset_{0};
+  uint32_t num_children_{0};
+  // Children added to the window being linked
+  uint32_t num_new_children_{0};
   std::vector<uint64_t> dep_unresolved_parent_ids_{};
-  std::unordered_map<std::string, const ChakraProtoMsg::AttributeProto&>
-      other_attrs_{};
+  // Parents that have not finished yet; the node is ready once it reaches 0.
+  // Atomic, along with children_freed_, as a concurrent feeder frees the
+  // children of several nodes at once.
+  std::atomic<uint32_t> num_unfinished_parents_{0};
+  std::atomic<bool> children_freed_{false};
 
   uint64_t id_;
-  std::string name_;
-  bool is_cpu_op_;
-  uint64_t runtime_;
-  uint64_t num_ops_;
-  uint32_t tensor_loc_;
-  uint64_t tensor_size_;
-  ChakraProtoMsg::CollectiveCommType comm_type_;
-  uint32_t comm_priority_;
-  uint64_t comm_size_;
-  uint32_t comm_src_;
-  uint32_t comm_dst_;
-  uint32_t comm_tag_;
-  std::string pg_name_;
-  std::string inputs_values_;
-  std::string inputs_shapes_;
-  std::string inputs_types_;
-  std::string outputs_values_;
-  std::string outputs_shapes_;
-  std::string outputs_types_;
+
+  // Filled in by decodeAttrs, once even if several threads read attributes:
+  // known attributes indexed by AttrId, and the others by name
+  mutable std::once_flag attrs_decoded_{};
+  mutable const ChakraProtoMsg::AttributeProto* known_attrs_[kNumAttrIds]{};
+  mutable std::unordered_map<std::string, const ChakraProtoMsg::AttributeProto&>
+      other_attrs_{};
 };
 
 } // namespace Chakra
@@ -0,0 +1,182 @@
+#include "et_index.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "et_def.pb.h"
+#include "protoio.hh"
+
+using namespace std;
+using namespace Chakra;
+
+namespace {
+// Size of the trace file, or -1 if it cannot be opened
+int64_t fileSize(const string& filename) {
+  ifstream file(filename, ios::in | ios::binary | ios::ate);
+  if (!file.is_open()) {
+    return -1;
+  }
+  return static_cast<int64_t>(file.tellg());
+}
+
+void putUint32(string& out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+void putUint64(string& out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+uint64_t getUint(const unsigned char* in, int num_bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < num_bytes; ++i) {
+    value |= static_cast<uint64_t>(in[i]) << (8 * i);
+  }
+  return value;
+}
+} // namespace
+
+ETIndex::ETIndex() : sorted_(true) {}
+
+unique_ptr<ETIndex> ETIndex::build(const string& trace_filename) {
+  ProtoInputStream trace(trace_filename);
+  if (!trace.is_open()) {
+    throw runtime_error("Failed to open trace file: " + trace_filename);
+  }
+
+  auto index = make_unique<ETIndex>();
+  ChakraProtoMsg::GlobalMetadata metadata;
+  trace.read(metadata);
+  ChakraProtoMsg::Node node;
+  uint64_t offset = trace.tell();
+  while (trace.read(node)) {
+    index->add(node.id(), offset);
+    offset = trace.tell();
+  }
+  return index;
+}
+
+unique_ptr<ETIndex> ETIndex::load(
+    const string& index_filename,
+    const string& trace_filename) {
+  ifstream file(index_filename, ios::in | ios::binary);
+  if (!file.is_open()) {
+    return nullptr;
+  }
+
+  // magic, version, trace size, number of entries
+  unsigned char header[24];
+  file.read(reinterpret_cast<char*>(header), sizeof(header));
+  if (!file.good() || getUint(header, 4) != kMagic ||
+      getUint(header + 4, 4) != kVersion ||
+      static_cast<int64_t>(getUint(header + 8, 8)) !=
+          fileSize(trace_filename)) {
+    return nullptr;
+  }
+
+  // The entries fill the rest of the file, which bounds the count before
+  // anything is allocated for them
+  uint64_t num_entries = getUint(header + 16, 8);
+  file.seekg(0, ios::end);
+  int64_t data_size = static_cast<int64_t>(file.tellg()) - sizeof(header);
+  if ((data_size < 0) || (data_size % 16 != 0) ||
+      (num_entries != static_cast<uint64_t>(data_size) / 16)) {
+    return nullptr;
+  }
+  file.seekg(sizeof(header));
+  string data(data_size, '\0');
+  file.read(&data[0], data.size());
+  if (!file.good()) {
+    return nullptr;
+  }
+
+  auto index = make_unique<ETIndex>();
+  index->entries_.reserve(num_entries);
+  const unsigned char* entry =
+      reinterpret_cast<const unsigned char*>(data.data());
+  for (uint64_t i = 0; i < num_entries; ++i, entry += 16) {
+    index->entries_.emplace_back(getUint(entry, 8), getUint(entry + 8, 8));
+  }
+  // Written sorted, but do not rely on it for a hand-made file
+  index->sorted_ = false;
+  index->sort();
+  return index;
+}
+
+string ETIndex::defaultFilename(const string& trace_filename) {
+  return trace_filename + ".etidx";
+}
+
+void ETIndex::add(uint64_t node_id, uint64_t offset) {
+  if (!entries_.empty() && node_id < entries_.back().first) {
+    sorted_ = false;
+  }
+  entries_.emplace_back(node_id, offset);
+}
+
+void ETIndex::write(
+    const string& index_filename,
+    const string& trace_filename) {
+  int64_t trace_size = fileSize(trace_filename);
+  if (trace_size < 0) {
+    throw runtime_error("Failed to open trace file: " + trace_filename);
+  }
+  sort();
+
+  string data;
+  data.reserve(24 + entries_.size() * 16);
+  putUint32(data, kMagic);
+  putUint32(data, kVersion);
+  putUint64(data, static_cast<uint64_t>(trace_size));
+  putUint64(data, entries_.size());
+  for (const auto& entry : entries_) {
+    putUint64(data, entry.first);
+    putUint64(data, entry.second);
+  }
+
+  ofstream file(index_filename, ios::out | ios::binary | ios::trunc);
+  file.write(data.data(), data.size());
+  if (!file.good()) {
+    throw runtime_error("Failed to write index file: " + index_filename);
+  }
+}
+
+bool ETIndex::find(uint64_t node_id, uint64_t& offset) {
+  sort();
+  auto it = lower_bound(
+      entries_.begin(),
+      entries_.end(),
+      node_id,
+      [](const pair<uint64_t, uint64_t>& entry, uint64_t node_id) {
+        return entry.first < node_id;
+      });
+  if (it == entries_.end() || it->first != node_id) {
+    return false;
+  }
+  offset = it->second;
+  return true;
+}
+
+size_t ETIndex::size() const {
+  return entries_.size();
+}
+
+void ETIndex::sort() {
+  if (sorted_) {
+    return;
+  }
+  // Keep the first occurrence of a node ID that appears more than once
+  stable_sort(
+      entries_.begin(),
+      entries_.end(),
+      [](const pair<uint64_t, uint64_t>& lhs,
+         const pair<uint64_t, uint64_t>& rhs) {
+        return lhs.first < rhs.first;
+      });
+  sorted_ = true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Chakra {
+
+// Sidecar index mapping node IDs to the offsets of their messages in a
+// trace, as given by ProtoInputStream::tell(). An index is either built by
+// scanning the trace, or filled while the trace is written by recording
+// ProtoOutputStream::tell() before each node. The index file records the
+// size of the trace it was built for, so that a stale index is ignored.
+class ETIndex {
+ public:
+  ETIndex();
+
+  // Reads every node of a trace and records where it starts
+  static std::unique_ptr<ETIndex> build(const std::string& trace_filename);
+  // Returns nullptr if the index file is missing, malformed, or was built
+  // for a trace of a different size
+  static std::unique_ptr<ETIndex> load(
+      const std::string& index_filename,
+      const std::string& trace_filename);
+  // <trace>.etidx
+  static std::string defaultFilename(const std::string& trace_filename);
+
+  void add(uint64_t node_id, uint64_t offset);
+  // The trace must be complete and closed, as its size is recorded
+  void write(
+      const std::string& index_filename,
+      const std::string& trace_filename);
+  bool find(uint64_t node_id, uint64_t& offset);
+  size_t size() const;
+
+ private:
+  static const uint32_t kMagic = 0x58495445; // "ETIX"
+  static const uint32_t kVersion = 1;
+
+  void sort();
+
+  // (node ID, offset) pairs, sorted by node ID once sorted_ is set
+  std::vector<std::pair<uint64_t, uint64_t>> entries_{};
+  bool sorted_;
+};
+
+} // namespace Chakra
@@ -0,0 +1,162 @@
+#include "feeder_stats.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace Chakra;
+
+void Log2Histogram::add(uint64_t value) {
+  size_t bucket = (value == 0) ? 0 : (64 - __builtin_clzll(value));
+  ++buckets_[bucket];
+  ++count_;
+  sum_ += value;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+}
+
+uint64_t Log2Histogram::count() const {
+  return count_;
+}
+
+uint64_t Log2Histogram::sum() const {
+  return sum_;
+}
+
+uint64_t Log2Histogram::min() const {
+  return (count_ == 0) ? 0 : min_;
+}
+
+uint64_t Log2Histogram::max() const {
+  return max_;
+}
+
+double Log2Histogram::mean() const {
+  return (count_ == 0) ? 0.0 : static_cast<double>(sum_) / count_;
+}
+
+uint64_t Log2Histogram::quantile(double q) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(q * (count_ - 1));
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < kNumBuckets; ++bucket) {
+    seen += buckets_[bucket];
+    if (seen > rank) {
+      // The bucket's upper bound, but never beyond the largest value
+      uint64_t bound = (bucket == 0) ? 0 : ((bucket == 64) ? UINT64_MAX
+                                            : (1ull << bucket) - 1);
+      return std::min(bound, max_);
+    }
+  }
+  return max_;
+}
+
+const array<uint64_t, Log2Histogram::kNumBuckets>& Log2Histogram::buckets()
+    const {
+  return buckets_;
+}
+
+double FeederStats::readNsPerNode() const {
+  return (num_nodes_read == 0) ? 0.0
+                               : static_cast<double>(read_ns) / num_nodes_read;
+}
+
+void FeederStats::addWindow(const WindowSample& window) {
+  ++num_windows;
+  num_nodes_read += window.num_nodes;
+  read_ns += window.read_ns;
+  bytes_read = window.bytes_read;
+  bytes_decompressed = window.bytes_decompressed;
+  peak_unresolved_nodes =
+      max(peak_unresolved_nodes, window.peak_unresolved_nodes);
+  peak_graph_nodes = max(peak_graph_nodes, window.num_graph_nodes);
+  peak_issuable_nodes = max(peak_issuable_nodes, window.num_issuable_nodes);
+  window_ns.add(window.duration_ns);
+  window_nodes.add(window.num_nodes);
+  issuable_nodes.add(window.num_issuable_nodes);
+  if (windows.size() < kMaxWindowSamples) {
+    windows.push_back(window);
+  }
+}
+
+namespace {
+void writeHistogram(ostream& out, const Log2Histogram& histogram) {
+  out << "{\"count\":" << histogram.count() << ",\"min\":" << histogram.min()
+      << ",\"mean\":" << histogram.mean()
+      << ",\"p50\":" << histogram.quantile(0.5)
+      << ",\"p99\":" << histogram.quantile(0.99)
+      << ",\"max\":" << histogram.max() << ",\"buckets\":[";
+  // Trailing empty buckets are left out
+  size_t num_buckets = Log2Histogram::kNumBuckets;
+  while (num_buckets > 0 && histogram.buckets()[num_buckets - 1] == 0) {
+    --num_buckets;
+  }
+  for (size_t i = 0; i < num_buckets; ++i) {
+    out << (i == 0 ? "" : ",") << histogram.buckets()[i];
+  }
+  out << "]}";
+}
+
+// Chrome trace timestamps are in microseconds
+string micros(uint64_t ns) {
+  ostringstream out;
+  out << ns / 1000 << "." << setw(3) << setfill('0') << ns % 1000;
+  return out.str();
+}
+} // namespace
+
+string FeederStats::toJson() const {
+  ostringstream out;
+  out << "{\"num_windows\":" << num_windows
+      << ",\"num_nodes_read\":" << num_nodes_read << ",\"read_ns\":" << read_ns
+      << ",\"read_ns_per_node\":" << readNsPerNode()
+      << ",\"bytes_read\":" << bytes_read
+      << ",\"bytes_decompressed\":" << bytes_decompressed
+      << ",\"peak_unresolved_nodes\":" << peak_unresolved_nodes
+      << ",\"peak_graph_nodes\":" << peak_graph_nodes
+      << ",\"peak_issuable_nodes\":" << peak_issuable_nodes
+      << ",\"node_read_ns\":";
+  writeHistogram(out, node_read_ns);
+  out << ",\"window_ns\":";
+  writeHistogram(out, window_ns);
+  out << ",\"window_nodes\":";
+  writeHistogram(out, window_nodes);
+  out << ",\"issuable_nodes\":";
+  writeHistogram(out, issuable_nodes);
+  out << "}";
+  return out.str();
+}
+
+void FeederStats::writeChromeTrace(const string& filename) const {
+  ofstream file(filename, ios::out | ios::trunc);
+  if (!file.is_open()) {
+    throw runtime_error("Failed to open " + filename + " for writing");
+  }
+  file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+       << "\"args\":{\"name\":\"ETFeeder\"}}";
+  for (const auto& window : windows) {
+    const string end = micros(window.start_ns + window.duration_ns);
+    file << ",\n{\"name\":\"readNextWindow\",\"ph\":\"X\",\"pid\":0,\"tid\":0,"
+         << "\"ts\":" << micros(window.start_ns)
+         << ",\"dur\":" << micros(window.duration_ns)
+         << ",\"args\":{\"nodes\":" << window.num_nodes
+         << ",\"read_ns\":" << window.read_ns << "}}";
+    file << ",\n{\"name\":\"nodes\",\"ph\":\"C\",\"pid\":0,\"ts\":" << end
+         << ",\"args\":{\"graph\":" << window.num_graph_nodes
+         << ",\"issuable\":" << window.num_issuable_nodes
+         << ",\"peak unresolved\":" << window.peak_unresolved_nodes << "}}";
+    file << ",\n{\"name\":\"bytes\",\"ph\":\"C\",\"pid\":0,\"ts\":" << end
+         << ",\"args\":{\"read\":" << window.bytes_read
+         << ",\"decompressed\":" << window.bytes_decompressed << "}}";
+  }
+  file << "],\n\"otherData\":" << toJson() << "}\n";
+  if (!file.good()) {
+    throw runtime_error("Failed to write " + filename);
+  }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Chakra {
+
+// Counts of values in power-of-two buckets: bucket 0 holds 0 and bucket i
+// holds the values in [2^(i-1), 2^i)
+class Log2Histogram {
+ public:
+  static constexpr size_t kNumBuckets = 65;
+
+  void add(uint64_t value);
+  uint64_t count() const;
+  uint64_t sum() const;
+  // 0 if nothing was added
+  uint64_t min() const;
+  uint64_t max() const;
+  double mean() const;
+  // Upper bound of the bucket holding the given quantile, in [0, 1]
+  uint64_t quantile(double q) const;
+  const std::array<uint64_t, kNumBuckets>& buckets() const;
+
+ private:
+  std::array<uint64_t, kNumBuckets> buckets_{};
+  uint64_t count_{0};
+  uint64_t sum_{0};
+  uint64_t min_{UINT64_MAX};
+  uint64_t max_{0};
+};
+
+// One call to ETFeeder::readNextWindow. Times are in nanoseconds since the
+// feeder was created, and byte counts are totals up to the end of the window.
+struct WindowSample {
+  uint64_t start_ns{0};
+  uint64_t duration_ns{0};
+  // Time spent getting nodes from the trace, including waits on the
+  // prefetch thread or the decode pool
+  uint64_t read_ns{0};
+  uint64_t num_nodes{0};
+  // Largest number of nodes waiting on a parent not read yet during the
+  // window, and the sizes of the graph and the issuable queue at its end
+  uint64_t peak_unresolved_nodes{0};
+  uint64_t num_graph_nodes{0};
+  uint64_t num_issuable_nodes{0};
+  uint64_t bytes_read{0};
+  uint64_t bytes_decompressed{0};
+};
+
+// Telemetry of a feeder, collected with ETFeederOptions::collect_stats
+struct FeederStats {
+  // Windows kept for the timeline; later windows only go into the totals
+  // and histograms
+  static constexpr size_t kMaxWindowSamples = 64 * 1024;
+
+  uint64_t num_windows{0};
+  uint64_t num_nodes_read{0};
+  uint64_t read_ns{0};
+  // Bytes read from the trace file, compressed if the trace is, and bytes
+  // of node records consumed. Reading a compressed trace again after
+  // suspend() counts its bytes again.
+  uint64_t bytes_read{0};
+  uint64_t bytes_decompressed{0};
+  uint64_t peak_unresolved_nodes{0};
+  uint64_t peak_graph_nodes{0};
+  uint64_t peak_issuable_nodes{0};
+  // Per node read, and per window
+  Log2Histogram node_read_ns{};
+  Log2Histogram window_ns{};
+  Log2Histogram window_nodes{};
+  Log2Histogram issuable_nodes{};
+  std::vector<WindowSample> windows{};
+
+  double readNsPerNode() const;
+  void addWindow(const WindowSample& window);
+  // Writes the totals and histograms as a JSON object
+  std::string toJson() const;
+  // Writes a trace viewable in chrome://tracing or Perfetto: one slice per
+  // window and counter tracks for the graph, the queue and the bytes read,
+  // with the totals of toJson() under "otherData"
+  void writeChromeTrace(const std::string& filename) const;
+};
+
+} // namespace Chakra
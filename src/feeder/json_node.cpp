@@ -3,192 +3,170 @@
 // JSONNode default constructor
 JSONNode::JSONNode() {}
 
-// JSONNode copy constructor
-JSONNode::JSONNode(const JSONNode& t) {
-  node_id = t.node_id;
-  node_name = t.node_name;
-  node_type = t.node_type;
-  is_cpu_op = t.is_cpu_op;
-  runtime = t.runtime;
-  data_deps = t.data_deps;
-  dep_unresolved_parent_ids_json = t.dep_unresolved_parent_ids_json;
-  children_vec_json = t.children_vec_json;
-  children_set_json = t.children_set_json;
-
-  if (node_type == NodeType::COMM_SEND_NODE ||
-      node_type == NodeType::COMM_RECV_NODE ||
-      node_type == NodeType::COMM_COLL_NODE) {
-    tensor_size = t.tensor_size;
-    comm_type = t.comm_type;
-    comm_priority = t.comm_priority;
-    comm_size = t.comm_size;
-    comm_src = t.comm_src;
-    comm_dst = t.comm_dst;
-    comm_tag = t.comm_tag;
-  }
+// JSONNode constructor from a table row
+JSONNode::JSONNode(std::shared_ptr<JSONNodeTable> table, uint32_t row)
+    : table_(std::move(table)), row_(row) {
+  table_->addRef(row_);
 }
 
-// JSONNode constructor
-JSONNode::JSONNode(json data, uint64_t id) {
-  try {
-    node_id = data["workload_graph"][id]["Id"];
-  } catch (...) {
-    std::cerr << "node_id not specified in ET" << std::endl;
-  }
-  try {
-    node_name = data["workload_graph"][id]["Name"];
-  } catch (...) {
-    std::cerr << "node_name not specified in ET" << std::endl;
-  }
-  try {
-    node_type = data["workload_graph"][id]["NodeType"];
-  } catch (...) {
-    std::cerr << "node_type not specified in ET" << std::endl;
-  }
-  try {
-    is_cpu_op = data["workload_graph"][id]["is_cpu_op"];
-  } catch (...) {
-    std::cerr << "is_cpu_op not specified in ET" << std::endl;
-  }
-  try {
-    runtime = data["workload_graph"][id]["runtime"];
-  } catch (...) {
-  }
-  try {
-    data_deps =
-        data["workload_graph"][id]["data_deps"].get<std::vector<uint64_t>>();
-  } catch (...) {
-    std::cerr << "data deps not specified in ET" << std::endl;
+// Copies refer to the row too
+JSONNode::JSONNode(const JSONNode& node)
+    : table_(node.table_), row_(node.row_) {
+  if (table_ != nullptr) {
+    table_->addRef(row_);
   }
+}
 
-  if (node_type == NodeType::COMM_SEND_NODE ||
-      node_type == NodeType::COMM_RECV_NODE ||
-      node_type == NodeType::COMM_COLL_NODE) {
-    try {
-      tensor_size = data["workload_graph"][id]["tensor_size"];
-    } catch (...) {
-    }
-    try {
-      comm_type = data["workload_graph"][id]["comm_type"];
-    } catch (...) {
-    }
-    try {
-      comm_priority = data["workload_graph"][id]["comm_priority"];
-    } catch (...) {
-      comm_priority = 0; // Protobuf defaults to 0
-    }
-    try {
-      comm_size = data["workload_graph"][id]["comm_size"];
-    } catch (...) {
-    }
-    try {
-      comm_src = data["workload_graph"][id]["comm_src"];
-    } catch (...) {
-    }
-    try {
-      comm_dst = data["workload_graph"][id]["comm_dst"];
-    } catch (...) {
-    }
-    try {
-      comm_tag = data["workload_graph"][id]["comm_tag"];
-    } catch (...) {
-    }
+// The reference moves along with the handle
+JSONNode::JSONNode(JSONNode&& node) noexcept
+    : table_(std::move(node.table_)), row_(node.row_) {
+  node.row_ = JSONNodeTable::kNoRow;
+}
+
+JSONNode& JSONNode::operator=(JSONNode node) noexcept {
+  std::swap(table_, node.table_);
+  std::swap(row_, node.row_);
+  return *this;
+}
+
+// Drop the reference to the row, which may let the table reuse it
+JSONNode::~JSONNode() {
+  if (table_ != nullptr) {
+    table_->removeRef(row_);
   }
 }
 
+// JSONNode constructor
+JSONNode::JSONNode(const json& data, uint64_t id)
+    : JSONNode(data.at("workload_graph").at(id)) {}
+
+// JSONNode constructor from a workload_graph element
+JSONNode::JSONNode(const json& node)
+    : table_(std::make_shared<JSONNodeTable>()) {
+  row_ = table_->append(node);
+  table_->addRef(row_);
+}
+
+// Row in the table
+uint32_t JSONNode::row() const {
+  return row_;
+}
+
+// Table holding the row
+const JSONNodeTable* JSONNode::table() const {
+  return table_.get();
+}
+
 // Node id
 uint64_t JSONNode::id() const {
-  return node_id;
+  return table_->id(row_);
 }
 
 // Node name
 std::string JSONNode::name() const {
-  return node_name;
+  return table_->name(row_);
 }
 
 // Node type
 int JSONNode::type() const {
-  return node_type;
+  return table_->type(row_);
 }
 
 // Check if CPU OP
 bool JSONNode::isCPUOp() const {
-  return is_cpu_op;
+  return table_->isCPUOp(row_);
 }
 
 // Runtime
 uint64_t JSONNode::getRuntime() const {
-  return runtime;
+  return table_->runtime(row_);
 }
 
 // Num ops
 uint64_t JSONNode::getNumOps() const {
-  return num_ops;
+  return table_->numOps(row_);
 }
 
 // Tensor size
 uint64_t JSONNode::getTensorSize() const {
-  return tensor_size;
+  return table_->tensorSize(row_);
 }
 
 // Comm type
 int64_t JSONNode::getCommType() const {
-  return comm_type;
+  return table_->commType(row_);
 }
 
 // Comm priority
 uint32_t JSONNode::getCommPriority() const {
-  return comm_priority;
+  return table_->commPriority(row_);
 }
 
 // Comm size
 uint64_t JSONNode::getCommSize() const {
-  return comm_size;
+  return table_->commSize(row_);
 }
 
 // Comm src
 uint32_t JSONNode::getCommSrc() const {
-  return comm_src;
+  return table_->commSrc(row_);
 }
 
 // Comm dst
 uint32_t JSONNode::getCommDst() const {
-  return comm_dst;
+  return table_->commDst(row_);
 }
 
 // Comm tag
 uint32_t JSONNode::getCommTag() const {
-  return comm_tag;
+  return table_->commTag(row_);
+}
+
+// Data dependencies, as listed in the trace
+std::vector<uint64_t> JSONNode::getDataDeps() const {
+  return std::vector<uint64_t>(
+      table_->dataDepsBegin(row_), table_->dataDepsEnd(row_));
 }
 
 // Dependency unresolved parent IDs
 void JSONNode::addDepUnresolvedParentID(uint64_t node_id) {
-  dep_unresolved_parent_ids_json.emplace_back(node_id);
+  table_->addDepUnresolvedParentID(row_, node_id);
 }
 
 // Get dependency unresolved parent IDs
-std::vector<uint64_t> JSONNode::getDepUnresolvedParentIDs() {
-  return dep_unresolved_parent_ids_json;
+std::vector<uint64_t> JSONNode::getDepUnresolvedParentIDs() const {
+  return table_->depUnresolvedParentIDs(row_);
+}
+
+// Remove a dependency unresolved parent ID
+size_t JSONNode::removeDepUnresolvedParentID(uint64_t node_id) {
+  return table_->removeDepUnresolvedParentID(row_, node_id);
 }
 
-// Set dependency unresolved parent IDs
-void JSONNode::setDepUnresolvedParentIDs(
-    std::vector<uint64_t> const& dep_unresolved_parent_ids) {
-  dep_unresolved_parent_ids_json = dep_unresolved_parent_ids;
+// Unfinished parents
+void JSONNode::addUnfinishedParent() {
+  table_->addUnfinishedParent(row_);
+}
+
+uint32_t JSONNode::removeUnfinishedParent() {
+  return table_->removeUnfinishedParent(row_);
+}
+
+uint32_t JSONNode::getNumUnfinishedParents() const {
+  return table_->numUnfinishedParents(row_);
 }
 
 // Add child
-void JSONNode::addChild(JSONNode node) {
-  // Avoid adding the same child node multiple times
-  // addChild is called multiple times to resolve dependencies
-  if (children_set_json.find(node) != children_set_json.end()) {
-    return;
-  }
-  children_vec_json.emplace_back(node);
-  children_set_json.emplace(node);
+void JSONNode::addChild(const JSONNode& node) {
+  table_->addChild(row_, node.row_);
 }
 
 // Get children vector
-std::vector<JSONNode> JSONNode::getChildren() {
-  return children_vec_json;
-}
\ No newline at end of file
+std::vector<JSONNode> JSONNode::getChildren() const {
+  std::vector<JSONNode> children;
+  children.reserve(table_->children(row_).size());
+  for (uint32_t child_row : table_->children(row_)) {
+    children.emplace_back(table_, child_row);
+  }
+  return children;
+}
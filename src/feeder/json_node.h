@@ -4,10 +4,13 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <queue>
 #include <set>
 #include <string>
 
+#include "json_node_table.h"
+
 using json = nlohmann::json;
 
 enum NodeType : int {
@@ -21,38 +24,28 @@ enum NodeType : int {
   COMM_COLL_NODE = 7
 };
 
+// Handle to a node of a JSON trace: a row of the table its fields were
+// decoded into, which also holds its dependency graph state. Copies are
+// cheap and refer to the same node, so that the graph, the queues and the
+// children lists share one copy of every node. The row is not reused while
+// a handle to it is alive, even once the node is removed from the graph.
 class JSONNode {
  private:
-  uint64_t node_id;
-  std::string node_name;
-  int node_type;
-  bool is_cpu_op;
-  uint64_t runtime;
-  uint64_t num_ops;
-  uint64_t tensor_size;
-  int64_t comm_type;
-  uint32_t comm_priority;
-  uint64_t comm_size;
-  uint32_t comm_src;
-  uint32_t comm_dst;
-  uint32_t comm_tag;
+  std::shared_ptr<JSONNodeTable> table_{nullptr};
+  uint32_t row_{JSONNodeTable::kNoRow};
 
  public:
-  std::vector<uint64_t> data_deps{};
-  std::vector<uint64_t> dep_unresolved_parent_ids_json{};
-  std::vector<JSONNode> children_vec_json{};
-
-  // Compare function for set
-  struct CompareJSONNodesLT {
-    bool operator()(const JSONNode& a, const JSONNode& b) const {
-      return a.node_id < b.node_id;
-    }
-  };
-  std::set<JSONNode, CompareJSONNodesLT> children_set_json{};
-
   JSONNode();
-  JSONNode(const JSONNode& t);
-  JSONNode(json data, uint64_t id);
+  JSONNode(std::shared_ptr<JSONNodeTable> table, uint32_t row);
+  JSONNode(const JSONNode& node);
+  JSONNode(JSONNode&& node) noexcept;
+  JSONNode& operator=(JSONNode node) noexcept;
+  ~JSONNode();
+  // Standalone nodes, decoded into a table of their own
+  JSONNode(const json& data, uint64_t id);
+  explicit JSONNode(const json& node);
+  uint32_t row() const;
+  const JSONNodeTable* table() const;
   uint64_t id() const;
   std::string name() const;
   int type() const;
@@ -66,51 +59,21 @@ class JSONNode {
   uint32_t getCommSrc() const;
   uint32_t getCommDst() const;
   uint32_t getCommTag() const;
+  std::vector<uint64_t> getDataDeps() const;
   void addDepUnresolvedParentID(uint64_t node_id);
-  std::vector<uint64_t> getDepUnresolvedParentIDs();
-  void setDepUnresolvedParentIDs(
-      std::vector<uint64_t> const& dep_unresolved_parent_ids);
-  void addChild(JSONNode node);
-  std::vector<JSONNode> getChildren();
+  std::vector<uint64_t> getDepUnresolvedParentIDs() const;
+  // Returns the number of unresolved parents left
+  size_t removeDepUnresolvedParentID(uint64_t node_id);
+  void addUnfinishedParent();
+  // Returns the number of unfinished parents left
+  uint32_t removeUnfinishedParent();
+  uint32_t getNumUnfinishedParents() const;
+  // The child must be in the same table. Children are not deduplicated.
+  void addChild(const JSONNode& node);
+  std::vector<JSONNode> getChildren() const;
 
-  // Define the == operator for comparison
   bool operator==(const JSONNode& other) const {
-    return node_id == other.node_id && node_name == other.node_name &&
-        node_type == other.node_type && is_cpu_op == other.is_cpu_op &&
-        runtime == other.runtime && num_ops == other.num_ops &&
-        tensor_size == other.tensor_size && comm_type == other.comm_type &&
-        comm_priority == other.comm_priority && comm_size == other.comm_size &&
-        comm_src == other.comm_src && comm_dst == other.comm_dst &&
-        comm_tag == other.comm_tag && data_deps == other.data_deps &&
-        dep_unresolved_parent_ids_json ==
-        other.dep_unresolved_parent_ids_json &&
-        children_vec_json == other.children_vec_json &&
-        children_set_json == other.children_set_json;
-  }
-
-  // Overload the assignment operator
-  JSONNode& operator=(const JSONNode& other) {
-    if (this != &other) {
-      // Copy all member variables
-      node_id = other.node_id;
-      node_name = other.node_name;
-      node_type = other.node_type;
-      is_cpu_op = other.is_cpu_op;
-      runtime = other.runtime;
-      num_ops = other.num_ops;
-      tensor_size = other.tensor_size;
-      comm_type = other.comm_type;
-      comm_priority = other.comm_priority;
-      comm_size = other.comm_size;
-      comm_src = other.comm_src;
-      comm_dst = other.comm_dst;
-      comm_tag = other.comm_tag;
-      data_deps = other.data_deps;
-      dep_unresolved_parent_ids_json = other.dep_unresolved_parent_ids_json;
-      children_vec_json = other.children_vec_json;
-      children_set_json = other.children_set_json;
-    }
-    return *this;
+    return table_ == other.table_ && row_ == other.row_;
   }
 };
 
@@ -119,32 +82,14 @@ namespace std {
 template <>
 struct hash<JSONNode> {
   std::size_t operator()(const JSONNode& node) const {
-    std::size_t h1 = std::hash<int64_t>()(node.id());
-    std::size_t h2 = std::hash<std::string>()(node.name());
-    std::size_t h3 = std::hash<int>()(node.type());
-    std::size_t h4 = std::hash<bool>()(node.isCPUOp());
-    std::size_t h5 = std::hash<int64_t>()(node.getRuntime());
-
-    // A prime number for bit manipulation
-    const std::size_t prime = 31;
-
-    // Combine the hash of the current member with the hashes of the previous
-    // members
-    std::size_t hash = h1;
-    hash = hash * prime + h2;
-    hash = hash * prime + h3;
-    hash = hash * prime + h4;
-    hash = hash * prime + h5;
-
-    return hash;
+    return std::hash<uint32_t>()(node.row());
   }
 };
 } // namespace std
 
 // Compare function for JSON node for priority queue
-struct CompareJSONNodesGT
-    : public std::binary_function<JSONNode, JSONNode, bool> {
-  bool operator()(const JSONNode lhs, const JSONNode rhs) const {
+struct CompareJSONNodesGT {
+  bool operator()(const JSONNode& lhs, const JSONNode& rhs) const {
     return lhs.id() > rhs.id();
   }
-};
\ No newline at end of file
+};
@@ -0,0 +1,305 @@
+#include "json_node_table.h"
+
+#include <algorithm>
+#include <iostream>
+
+using json = nlohmann::json;
+
+namespace {
+// Reads a number field into value, returning false if the node has no such
+// field or it is not a number
+template <typename T>
+bool getNumber(const json& node, const char* key, T& value) {
+  auto field = node.find(key);
+  if ((field == node.end()) || !field->is_number()) {
+    return false;
+  }
+  value = field->get<T>();
+  return true;
+}
+} // namespace
+
+uint32_t JSONNodeTable::append(const json& node) {
+  uint32_t row;
+  if (free_rows_.empty()) {
+    row = static_cast<uint32_t>(ids_.size());
+    ids_.emplace_back();
+    names_.emplace_back();
+    types_.emplace_back();
+    is_cpu_ops_.emplace_back();
+    runtimes_.emplace_back();
+    num_ops_.emplace_back();
+    tensor_sizes_.emplace_back();
+    comm_types_.emplace_back();
+    comm_priorities_.emplace_back();
+    comm_sizes_.emplace_back();
+    comm_srcs_.emplace_back();
+    comm_dsts_.emplace_back();
+    comm_tags_.emplace_back();
+    data_deps_.emplace_back();
+    children_.emplace_back();
+    num_unfinished_parents_.emplace_back();
+    dep_unresolved_parent_ids_.emplace_back();
+    num_refs_.emplace_back();
+    released_.emplace_back();
+  } else {
+    // A released row keeps the storage of its lists for this node
+    row = free_rows_.back();
+    free_rows_.pop_back();
+    released_[row] = false;
+    data_deps_[row].clear();
+    num_unfinished_parents_[row] = 0;
+    dep_unresolved_parent_ids_[row].clear();
+  }
+
+  uint64_t id = 0;
+  if (!getNumber(node, "Id", id)) {
+    std::cerr << "node_id not specified in ET" << std::endl;
+  }
+  std::string& name = names_[row];
+  auto name_field = node.find("Name");
+  if ((name_field != node.end()) && name_field->is_string()) {
+    name = name_field->get<std::string>();
+  } else {
+    name.clear();
+    std::cerr << "node_name not specified in ET" << std::endl;
+  }
+  int32_t type = 0;
+  if (!getNumber(node, "NodeType", type)) {
+    std::cerr << "node_type not specified in ET" << std::endl;
+  }
+  bool is_cpu_op = false;
+  auto is_cpu_op_field = node.find("is_cpu_op");
+  if ((is_cpu_op_field != node.end()) && is_cpu_op_field->is_boolean()) {
+    is_cpu_op = is_cpu_op_field->get<bool>();
+  } else {
+    std::cerr << "is_cpu_op not specified in ET" << std::endl;
+  }
+  auto data_deps = node.find("data_deps");
+  if ((data_deps != node.end()) && data_deps->is_array()) {
+    for (const auto& dep : *data_deps) {
+      if (dep.is_number()) {
+        data_deps_[row].push_back(dep.get<uint64_t>());
+      }
+    }
+  } else {
+    std::cerr << "data deps not specified in ET" << std::endl;
+  }
+
+  ids_[row] = id;
+  types_[row] = type;
+  is_cpu_ops_[row] = is_cpu_op;
+  runtimes_[row] = 0;
+  getNumber(node, "runtime", runtimes_[row]);
+  num_ops_[row] = 0;
+  getNumber(node, "num_ops", num_ops_[row]);
+  tensor_sizes_[row] = 0;
+  getNumber(node, "tensor_size", tensor_sizes_[row]);
+  comm_types_[row] = 0;
+  getNumber(node, "comm_type", comm_types_[row]);
+  comm_priorities_[row] = 0;
+  getNumber(node, "comm_priority", comm_priorities_[row]);
+  comm_sizes_[row] = 0;
+  getNumber(node, "comm_size", comm_sizes_[row]);
+  comm_srcs_[row] = 0;
+  getNumber(node, "comm_src", comm_srcs_[row]);
+  comm_dsts_[row] = 0;
+  getNumber(node, "comm_dst", comm_dsts_[row]);
+  comm_tags_[row] = 0;
+  getNumber(node, "comm_tag", comm_tags_[row]);
+
+  rows_[id] = row;
+  return row;
+}
+
+size_t JSONNodeTable::size() const {
+  return ids_.size() - free_rows_.size();
+}
+
+uint32_t JSONNodeTable::findRow(uint64_t node_id) const {
+  auto row = rows_.find(node_id);
+  if (row == rows_.end()) {
+    return kNoRow;
+  }
+  return row->second;
+}
+
+void JSONNodeTable::releaseRow(uint32_t row) {
+  if (released_[row]) {
+    return;
+  }
+  released_[row] = true;
+  // A later node with the same ID may have taken over the index entry
+  auto entry = rows_.find(ids_[row]);
+  if ((entry != rows_.end()) && (entry->second == row)) {
+    rows_.erase(entry);
+  }
+  if (num_refs_[row] == 0) {
+    recycleRow(row);
+  }
+}
+
+void JSONNodeTable::restoreRow(uint32_t row) {
+  if (!released_[row]) {
+    return;
+  }
+  released_[row] = false;
+  rows_[ids_[row]] = row;
+}
+
+void JSONNodeTable::addRef(uint32_t row) {
+  ++num_refs_[row];
+}
+
+void JSONNodeTable::removeRef(uint32_t row) {
+  if ((--num_refs_[row] == 0) && released_[row]) {
+    recycleRow(row);
+  }
+}
+
+void JSONNodeTable::recycleRow(uint32_t row) {
+  // A work list rather than recursion, as the children may form long chains
+  std::vector<uint32_t> rows{row};
+  while (!rows.empty()) {
+    uint32_t free_row = rows.back();
+    rows.pop_back();
+    for (uint32_t child_row : children_[free_row]) {
+      if ((--num_refs_[child_row] == 0) && released_[child_row]) {
+        rows.push_back(child_row);
+      }
+    }
+    children_[free_row].clear();
+    free_rows_.push_back(free_row);
+  }
+}
+
+void JSONNodeTable::clear() {
+  ids_.clear();
+  names_.clear();
+  types_.clear();
+  is_cpu_ops_.clear();
+  runtimes_.clear();
+  num_ops_.clear();
+  tensor_sizes_.clear();
+  comm_types_.clear();
+  comm_priorities_.clear();
+  comm_sizes_.clear();
+  comm_srcs_.clear();
+  comm_dsts_.clear();
+  comm_tags_.clear();
+  data_deps_.clear();
+  rows_.clear();
+  num_refs_.clear();
+  released_.clear();
+  free_rows_.clear();
+  children_.clear();
+  num_unfinished_parents_.clear();
+  dep_unresolved_parent_ids_.clear();
+}
+
+uint64_t JSONNodeTable::id(uint32_t row) const {
+  return ids_[row];
+}
+
+const std::string& JSONNodeTable::name(uint32_t row) const {
+  return names_[row];
+}
+
+int JSONNodeTable::type(uint32_t row) const {
+  return types_[row];
+}
+
+bool JSONNodeTable::isCPUOp(uint32_t row) const {
+  return is_cpu_ops_[row];
+}
+
+uint64_t JSONNodeTable::runtime(uint32_t row) const {
+  return runtimes_[row];
+}
+
+uint64_t JSONNodeTable::numOps(uint32_t row) const {
+  return num_ops_[row];
+}
+
+uint64_t JSONNodeTable::tensorSize(uint32_t row) const {
+  return tensor_sizes_[row];
+}
+
+int64_t JSONNodeTable::commType(uint32_t row) const {
+  return comm_types_[row];
+}
+
+uint32_t JSONNodeTable::commPriority(uint32_t row) const {
+  return comm_priorities_[row];
+}
+
+uint64_t JSONNodeTable::commSize(uint32_t row) const {
+  return comm_sizes_[row];
+}
+
+uint32_t JSONNodeTable::commSrc(uint32_t row) const {
+  return comm_srcs_[row];
+}
+
+uint32_t JSONNodeTable::commDst(uint32_t row) const {
+  return comm_dsts_[row];
+}
+
+uint32_t JSONNodeTable::commTag(uint32_t row) const {
+  return comm_tags_[row];
+}
+
+const uint64_t* JSONNodeTable::dataDepsBegin(uint32_t row) const {
+  return data_deps_[row].data();
+}
+
+const uint64_t* JSONNodeTable::dataDepsEnd(uint32_t row) const {
+  return data_deps_[row].data() + data_deps_[row].size();
+}
+
+void JSONNodeTable::addChild(uint32_t row, uint32_t child_row) {
+  children_[row].push_back(child_row);
+  ++num_refs_[child_row];
+}
+
+const std::vector<uint32_t>& JSONNodeTable::children(uint32_t row) const {
+  return children_[row];
+}
+
+void JSONNodeTable::addUnfinishedParent(uint32_t row) {
+  ++num_unfinished_parents_[row];
+}
+
+uint32_t JSONNodeTable::removeUnfinishedParent(uint32_t row) {
+  if (num_unfinished_parents_[row] > 0) {
+    --num_unfinished_parents_[row];
+  }
+  return num_unfinished_parents_[row];
+}
+
+uint32_t JSONNodeTable::numUnfinishedParents(uint32_t row) const {
+  return num_unfinished_parents_[row];
+}
+
+void JSONNodeTable::addDepUnresolvedParentID(
+    uint32_t row,
+    uint64_t parent_id) {
+  dep_unresolved_parent_ids_[row].push_back(parent_id);
+}
+
+size_t JSONNodeTable::removeDepUnresolvedParentID(
+    uint32_t row,
+    uint64_t parent_id) {
+  auto& parent_ids = dep_unresolved_parent_ids_[row];
+  auto parent = std::find(parent_ids.begin(), parent_ids.end(), parent_id);
+  if (parent != parent_ids.end()) {
+    *parent = parent_ids.back();
+    parent_ids.pop_back();
+  }
+  return parent_ids.size();
+}
+
+const std::vector<uint64_t>& JSONNodeTable::depUnresolvedParentIDs(
+    uint32_t row) const {
+  return dep_unresolved_parent_ids_[row];
+}
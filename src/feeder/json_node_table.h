@@ -0,0 +1,106 @@
+#pragma once
+
+#include <json/json.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Decoded fields of the nodes of a JSON trace, one column per field and one
+// row per node in the order the nodes were read, with an index from node ID
+// to row. Each node is decoded once when it is appended, so that reading a
+// field is an array access rather than a lookup in the JSON object. Fields
+// missing from a node read as 0, false or "".
+//
+// The table also keeps the dependency graph state of each node, which
+// JSONNode handles refer to by row: its children, as rows, and its parents
+// that have not finished or not been read yet.
+//
+// Rows of released nodes are reused by the nodes appended after them, so
+// the table holds about as many rows as the most nodes in the graph at
+// once. A row is only reused once no JSONNode handle and no children list
+// refers to it, so a handle keeps reading the node it was made for.
+class JSONNodeTable {
+ public:
+  static constexpr uint32_t kNoRow = UINT32_MAX;
+
+  // Decodes a workload_graph element into a released row, or a new one if
+  // there is none, returning its index. A node with the ID of an earlier one
+  // replaces it in the index.
+  uint32_t append(const nlohmann::json& node);
+  // Number of rows in use
+  size_t size() const;
+  // Row of the node with the given ID, or kNoRow if it has not been read or
+  // has been released
+  uint32_t findRow(uint64_t node_id) const;
+  // Drops the row of a node that is done with from the index, and hands it
+  // back for reuse once nothing refers to it
+  void releaseRow(uint32_t row);
+  // Puts a released row that is still referred to back in the index, for a
+  // removed node that is added back
+  void restoreRow(uint32_t row);
+  // References held by JSONNode handles
+  void addRef(uint32_t row);
+  void removeRef(uint32_t row);
+  // Drops every row, keeping the storage of the columns for the next ones
+  void clear();
+
+  uint64_t id(uint32_t row) const;
+  const std::string& name(uint32_t row) const;
+  int type(uint32_t row) const;
+  bool isCPUOp(uint32_t row) const;
+  uint64_t runtime(uint32_t row) const;
+  uint64_t numOps(uint32_t row) const;
+  uint64_t tensorSize(uint32_t row) const;
+  int64_t commType(uint32_t row) const;
+  uint32_t commPriority(uint32_t row) const;
+  uint64_t commSize(uint32_t row) const;
+  uint32_t commSrc(uint32_t row) const;
+  uint32_t commDst(uint32_t row) const;
+  uint32_t commTag(uint32_t row) const;
+  // Data dependencies of a node, as listed in the trace
+  const uint64_t* dataDepsBegin(uint32_t row) const;
+  const uint64_t* dataDepsEnd(uint32_t row) const;
+
+  // Children are not deduplicated, and each entry refers to the child's row
+  void addChild(uint32_t row, uint32_t child_row);
+  const std::vector<uint32_t>& children(uint32_t row) const;
+  void addUnfinishedParent(uint32_t row);
+  // Returns the number of unfinished parents left
+  uint32_t removeUnfinishedParent(uint32_t row);
+  uint32_t numUnfinishedParents(uint32_t row) const;
+  void addDepUnresolvedParentID(uint32_t row, uint64_t parent_id);
+  // Returns the number of unresolved parents left
+  size_t removeDepUnresolvedParentID(uint32_t row, uint64_t parent_id);
+  const std::vector<uint64_t>& depUnresolvedParentIDs(uint32_t row) const;
+
+ private:
+  // Reuses a released row that nothing refers to, along with the rows of
+  // its children that only it referred to
+  void recycleRow(uint32_t row);
+
+  std::vector<uint64_t> ids_{};
+  std::vector<std::string> names_{};
+  std::vector<int32_t> types_{};
+  std::vector<bool> is_cpu_ops_{};
+  std::vector<uint64_t> runtimes_{};
+  std::vector<uint64_t> num_ops_{};
+  std::vector<uint64_t> tensor_sizes_{};
+  std::vector<int64_t> comm_types_{};
+  std::vector<uint32_t> comm_priorities_{};
+  std::vector<uint64_t> comm_sizes_{};
+  std::vector<uint32_t> comm_srcs_{};
+  std::vector<uint32_t> comm_dsts_{};
+  std::vector<uint32_t> comm_tags_{};
+  std::vector<std::vector<uint64_t>> data_deps_{};
+  std::unordered_map<uint64_t, uint32_t> rows_{};
+  // References to each row, and whether it has been released
+  std::vector<uint32_t> num_refs_{};
+  std::vector<bool> released_{};
+  // Released rows that nothing refers to, reused last released first
+  std::vector<uint32_t> free_rows_{};
+
+  std::vector<std::vector<uint32_t>> children_{};
+  std::vector<uint32_t> num_unfinished_parents_{};
+  std::vector<std::vector<uint64_t>> dep_unresolved_parent_ids_{};
+};
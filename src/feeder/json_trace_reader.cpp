@@ -0,0 +1,177 @@
+#include "json_trace_reader.h"
+
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+JSONTraceReader::JSONTraceReader(const std::string& filename, size_t chunk_size)
+    : filename_(filename),
+      file_(filename, std::ios::in | std::ios::binary),
+      chunk_size_(chunk_size) {
+  if (!file_.is_open()) {
+    return;
+  }
+  skipWhitespace();
+  expect('{');
+}
+
+bool JSONTraceReader::is_open() const {
+  return file_.is_open();
+}
+
+uint64_t JSONTraceReader::numNodesRead() const {
+  return num_nodes_read_;
+}
+
+int JSONTraceReader::peek(size_t offset) {
+  while (pos_ + offset >= buffer_.size()) {
+    if (!fill()) {
+      return -1;
+    }
+  }
+  return static_cast<unsigned char>(buffer_[pos_ + offset]);
+}
+
+bool JSONTraceReader::fill() {
+  if (!file_.good()) {
+    return false;
+  }
+  buffer_.erase(0, pos_);
+  pos_ = 0;
+  size_t size = buffer_.size();
+  buffer_.resize(size + chunk_size_);
+  file_.read(&buffer_[size], chunk_size_);
+  buffer_.resize(size + file_.gcount());
+  return file_.gcount() > 0;
+}
+
+void JSONTraceReader::skipWhitespace() {
+  int c;
+  while ((c = peek(0)) == ' ' || c == '\n' || c == '\r' || c == '\t') {
+    ++pos_;
+  }
+}
+
+void JSONTraceReader::expect(char c) {
+  if (peek(0) != static_cast<unsigned char>(c)) {
+    throw std::runtime_error(
+        "Expected '" + std::string(1, c) + "' in JSON trace " + filename_);
+  }
+  ++pos_;
+}
+
+size_t JSONTraceReader::stringLength() {
+  // Past the opening quote
+  for (size_t length = 1;; ++length) {
+    int c = peek(length);
+    if (c == -1) {
+      break;
+    } else if (c == '\\') {
+      ++length;
+    } else if (c == '"') {
+      return length + 1;
+    }
+  }
+  throw std::runtime_error("Unterminated string in JSON trace " + filename_);
+}
+
+size_t JSONTraceReader::valueLength() {
+  int c = peek(0);
+  if (c == '"') {
+    return stringLength();
+  }
+  if (c != '{' && c != '[') {
+    // A number, true, false or null
+    size_t length = 0;
+    while ((c = peek(length)) != -1 && c != ',' && c != '}' && c != ']' &&
+           c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+      ++length;
+    }
+    return length;
+  }
+
+  uint64_t depth = 0;
+  bool in_string = false;
+  for (size_t length = 0;; ++length) {
+    c = peek(length);
+    if (c == -1) {
+      break;
+    }
+    if (in_string) {
+      if (c == '\\') {
+        ++length;
+      } else if (c == '"') {
+        in_string = false;
+      }
+    } else if (c == '"') {
+      in_string = true;
+    } else if (c == '{' || c == '[') {
+      ++depth;
+    } else if ((c == '}' || c == ']') && (--depth == 0)) {
+      return length + 1;
+    }
+  }
+  throw std::runtime_error("Unexpected end of JSON trace " + filename_);
+}
+
+bool JSONTraceReader::findWorkloadGraph() {
+  bool first_member = true;
+  while (true) {
+    skipWhitespace();
+    if (peek(0) == '}') {
+      return false;
+    }
+    if (!first_member) {
+      expect(',');
+      skipWhitespace();
+    }
+    first_member = false;
+    if (peek(0) != '"') {
+      throw std::runtime_error("Expected a member name in JSON trace " +
+                               filename_);
+    }
+    size_t length = stringLength();
+    bool is_graph = buffer_.compare(pos_, length, "\"workload_graph\"") == 0;
+    pos_ += length;
+    skipWhitespace();
+    expect(':');
+    skipWhitespace();
+    if (is_graph) {
+      expect('[');
+      return true;
+    }
+    pos_ += valueLength();
+  }
+}
+
+bool JSONTraceReader::next(json& node) {
+  if (state_ == State::Object) {
+    if (!findWorkloadGraph()) {
+      throw std::runtime_error(
+          "No workload_graph array in JSON trace " + filename_);
+    }
+    state_ = State::Graph;
+  }
+  if (state_ == State::Done) {
+    return false;
+  }
+
+  skipWhitespace();
+  if (peek(0) == ']') {
+    // The members after the graph are not needed
+    ++pos_;
+    state_ = State::Done;
+    return false;
+  }
+  if (!first_node_) {
+    expect(',');
+    skipWhitespace();
+  }
+  first_node_ = false;
+  size_t length = valueLength();
+  const char* begin = buffer_.data() + pos_;
+  node = json::parse(begin, begin + length);
+  pos_ += length;
+  ++num_nodes_read_;
+  return true;
+}
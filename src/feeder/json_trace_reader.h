@@ -0,0 +1,52 @@
+#pragma once
+
+#include <json/json.hpp>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Reads the nodes of a JSON trace one at a time instead of parsing the whole
+// file into a DOM. The top-level object is scanned for its "workload_graph"
+// array, skipping the other members, and each node object is parsed on its
+// own once its extent in the file is known, so that only the node being read
+// and a buffer of the file are held in memory.
+class JSONTraceReader {
+ public:
+  explicit JSONTraceReader(
+      const std::string& filename,
+      size_t chunk_size = 1 << 20);
+
+  bool is_open() const;
+  // Parses the next node of the workload graph, returning false after the
+  // last one. Throws std::runtime_error if the file is not a JSON object
+  // with a workload_graph array, and nlohmann's parse errors for a
+  // malformed node.
+  bool next(nlohmann::json& node);
+  uint64_t numNodesRead() const;
+
+ private:
+  // Byte at the given distance from the read position, or -1 past the end
+  // of the file
+  int peek(size_t offset);
+  // Drops the bytes before the read position and reads the next chunk
+  bool fill();
+  void skipWhitespace();
+  void expect(char c);
+  // Length of the string or value starting at the read position
+  size_t stringLength();
+  size_t valueLength();
+  // Moves to the start of the workload graph, returning false if the
+  // object has no such member
+  bool findWorkloadGraph();
+
+  enum class State { Object, Graph, Done };
+
+  const std::string filename_;
+  std::ifstream file_;
+  const size_t chunk_size_;
+  std::string buffer_{};
+  size_t pos_{0};
+  State state_{State::Object};
+  bool first_node_{true};
+  uint64_t num_nodes_read_{0};
+};
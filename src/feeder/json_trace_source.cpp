@@ -0,0 +1,245 @@
+#include "json_trace_source.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+JSONTraceSource::JSONTraceSource(const std::string& filename, int window_size)
+    : reader_(std::make_unique<JSONTraceReader>(filename)),
+      table_(std::make_shared<JSONNodeTable>()),
+      window_size_(window_size) {
+  if (!reader_->is_open()) {
+    throw std::runtime_error("Failed to open " + filename);
+  }
+  readNextWindow();
+}
+
+// Add node to dependency graph
+// A removed node added back is found by its ID again
+void JSONTraceSource::addNode(JSONNode node) {
+  if (node.table() == table_.get()) {
+    table_->restoreRow(node.row());
+  }
+  uint64_t node_id = node.id();
+  dep_graph_[node_id] = std::move(node);
+}
+
+// Read the next node of the trace into the graph
+bool JSONTraceSource::readNode(JSONNode& node) {
+  json data;
+  if (!reader_->next(data)) {
+    return false;
+  }
+  node = JSONNode(table_, table_->append(data));
+
+  bool dep_unresolved = false;
+  const uint64_t* data_deps = table_->dataDepsBegin(node.row());
+  const uint64_t* data_deps_end = table_->dataDepsEnd(node.row());
+  for (const uint64_t* dep = data_deps; dep != data_deps_end; ++dep) {
+    // Parents that have already finished are not waited on, and a parent
+    // listed more than once is counted once
+    if (isNodeFinished(*dep) ||
+        (std::find(data_deps, dep, *dep) != dep)) {
+      continue;
+    }
+    node.addUnfinishedParent();
+    auto parent_node = dep_graph_.find(*dep);
+    if (parent_node != dep_graph_.end()) {
+      parent_node->second.addChild(node);
+    } else {
+      dep_unresolved = true;
+      node.addDepUnresolvedParentID(*dep);
+      dep_unresolved_child_map_[*dep].push_back(node);
+    }
+  }
+
+  if (dep_unresolved) {
+    dep_unresolved_node_set_.emplace(node);
+  }
+
+  return true;
+}
+
+// Read nodes in a window
+// A window holds at least window_size_ nodes, and goes on while a node read
+// waits on a parent that has not been read yet
+void JSONTraceSource::readNextWindow() {
+  std::vector<JSONNode> new_nodes;
+  do {
+    JSONNode new_node;
+    if (!readNode(new_node)) {
+      et_complete_ = true;
+      break;
+    }
+    addNode(new_node);
+    new_nodes.push_back(new_node);
+    resolveDep(new_node);
+  } while ((new_nodes.size() < static_cast<size_t>(window_size_)) ||
+           (dep_unresolved_node_set_.size() != 0));
+
+  // Only nodes read in this window can be queued here; the others were
+  // queued when their parents were freed, or have been issued already
+  for (const auto& node : new_nodes) {
+    uint64_t node_id = node.id();
+    // Unordered set does not allow duplicates. So, count returns 1 if key
+    // exists, 0 otherwise
+    if ((dep_graph_.count(node_id) != 0) &&
+        (dep_free_node_id_set_.count(node_id) == 0) &&
+        (node.getNumUnfinishedParents() == 0)) {
+      dep_free_node_id_set_.emplace(node_id);
+      dep_free_node_queue_.emplace(node);
+    }
+  }
+}
+
+// Find the row of a node in the table, or -1 if it has not been read
+int64_t JSONTraceSource::findNodeIndex(uint64_t node_id) const {
+  uint32_t row = table_->findRow(node_id);
+  if (row == JSONNodeTable::kNoRow) {
+    return -1;
+  }
+  return row;
+}
+
+// Remove node from dependency graph
+// Its row is reused by the nodes read next, once no handle refers to it
+void JSONTraceSource::removeNode(uint64_t node_id) {
+  auto node = dep_graph_.find(node_id);
+  if (node != dep_graph_.end()) {
+    table_->releaseRow(node->second.row());
+    dep_graph_.erase(node);
+  }
+  if (!et_complete_ &&
+      (dep_free_node_queue_.size() < static_cast<size_t>(window_size_))) {
+    readNextWindow();
+  }
+}
+
+// Resolve dependencies
+void JSONTraceSource::resolveDep() {
+  // Link the nodes waiting on parents that are in the graph by now
+  std::vector<JSONNode> parents;
+  for (const auto& parent_id_children : dep_unresolved_child_map_) {
+    auto parent_node = dep_graph_.find(parent_id_children.first);
+    if (parent_node != dep_graph_.end()) {
+      parents.push_back(parent_node->second);
+    }
+  }
+  for (const auto& parent : parents) {
+    resolveDep(parent);
+  }
+}
+
+void JSONTraceSource::resolveDep(JSONNode node) {
+  auto waiting = dep_unresolved_child_map_.find(node.id());
+  if (waiting == dep_unresolved_child_map_.end()) {
+    return;
+  }
+  for (auto& child : waiting->second) {
+    node.addChild(child);
+    if (child.removeDepUnresolvedParentID(node.id()) == 0) {
+      dep_unresolved_node_set_.erase(child);
+    }
+  }
+  dep_unresolved_child_map_.erase(waiting);
+}
+
+// Push dependency free nodes
+void JSONTraceSource::pushBackIssuableNode(uint64_t node_id) {
+  auto node = dep_graph_.find(node_id);
+  if (node != dep_graph_.end()) {
+    dep_free_node_id_set_.emplace(node_id);
+    dep_free_node_queue_.emplace(node->second);
+  }
+}
+
+// Free children
+void JSONTraceSource::freeChildrenNodes(uint64_t node_id) {
+  // Children are only freed once, as each of them counts this node once
+  auto node = dep_graph_.find(node_id);
+  if (!markNodeFinished(node_id) || (node == dep_graph_.end())) {
+    return;
+  }
+  for (auto& child : node->second.getChildren()) {
+    if ((child.removeUnfinishedParent() == 0) &&
+        (dep_free_node_id_set_.count(child.id()) == 0)) {
+      dep_free_node_id_set_.emplace(child.id());
+      dep_free_node_queue_.emplace(child);
+    }
+  }
+}
+
+// IDs below this bound are tracked in the bitmap
+static constexpr uint64_t kMaxBitmapNodeID = 1ull << 28;
+
+bool JSONTraceSource::markNodeFinished(uint64_t node_id) {
+  if (node_id >= kMaxBitmapNodeID) {
+    return finished_node_id_set_.emplace(node_id).second;
+  }
+  size_t word = node_id / 64;
+  if (word >= finished_node_bitmap_.size()) {
+    finished_node_bitmap_.resize(
+        std::max(word + 1, finished_node_bitmap_.size() * 2), 0);
+  }
+  const uint64_t bit = 1ull << (node_id % 64);
+  if ((finished_node_bitmap_[word] & bit) != 0) {
+    return false;
+  }
+  finished_node_bitmap_[word] |= bit;
+  return true;
+}
+
+bool JSONTraceSource::isNodeFinished(uint64_t node_id) const {
+  if (node_id >= kMaxBitmapNodeID) {
+    return finished_node_id_set_.count(node_id) != 0;
+  }
+  size_t word = node_id / 64;
+  return (word < finished_node_bitmap_.size()) &&
+      ((finished_node_bitmap_[word] >> (node_id % 64)) & 1);
+}
+
+// Check if has more nodes to issue
+bool JSONTraceSource::hasNodesToIssue() {
+  return !(dep_graph_.empty() && dep_free_node_queue_.empty());
+}
+
+// Get next issuable node from dependency free queue
+bool JSONTraceSource::getNextIssuableNode(TraceNodeFields& fields) {
+  if (dep_free_node_queue_.empty()) {
+    return false;
+  }
+  select(dep_free_node_queue_.top(), fields);
+  dep_free_node_id_set_.erase(fields.id);
+  dep_free_node_queue_.pop();
+  return true;
+}
+
+// Lookup node
+void JSONTraceSource::lookupNode(uint64_t node_id, TraceNodeFields& fields) {
+  try {
+    select(dep_graph_.at(node_id), fields);
+  } catch (const std::out_of_range& e) {
+    std::cerr << "looking for node_id=" << node_id
+              << " in dep graph, however, not loaded yet" << std::endl;
+    throw(e);
+  }
+}
+
+void JSONTraceSource::readFields(TraceNodeFields& fields) const {
+  uint32_t row = static_cast<const JSONNode*>(fields.node.get())->row();
+  fields.id = table_->id(row);
+  fields.name = table_->name(row);
+  fields.type = table_->type(row);
+  fields.is_cpu_op = table_->isCPUOp(row);
+  fields.runtime = table_->runtime(row);
+  fields.num_ops = table_->numOps(row);
+  fields.tensor_size = table_->tensorSize(row);
+  fields.comm_type = table_->commType(row);
+  fields.comm_priority = table_->commPriority(row);
+  fields.comm_size = table_->commSize(row);
+  fields.comm_src = table_->commSrc(row);
+  fields.comm_dst = table_->commDst(row);
+  fields.comm_tag = table_->commTag(row);
+  fields.has_details = true;
+}
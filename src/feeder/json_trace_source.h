@@ -0,0 +1,66 @@
+#pragma once
+
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "json_node.h"
+#include "json_trace_reader.h"
+#include "trace_source.h"
+
+// JSON traces, read window by window without a DOM of the whole file. The
+// fields and graph state of every node read so far are kept in a
+// JSONNodeTable, which the JSONNode handles refer to.
+class JSONTraceSource final : public BasicTraceSource<JSONNode> {
+ public:
+  // Throws std::runtime_error if the file cannot be opened. Windows hold at
+  // least window_size nodes.
+  JSONTraceSource(const std::string& filename, int window_size);
+
+  void addNode(JSONNode node);
+  void readNextWindow();
+  // Reads the next node into the graph, returning false after the last one
+  bool readNode(JSONNode& node);
+  // Row of a node in the table, or -1 if it has not been read
+  int64_t findNodeIndex(uint64_t node_id) const;
+
+  void removeNode(uint64_t node_id) override;
+  void resolveDep() override;
+  void pushBackIssuableNode(uint64_t node_id) override;
+  void freeChildrenNodes(uint64_t node_id) override;
+  bool hasNodesToIssue() override;
+  bool getNextIssuableNode(TraceNodeFields& fields) override;
+  void lookupNode(uint64_t node_id, TraceNodeFields& fields) override;
+
+ private:
+  void readFields(TraceNodeFields& fields) const override;
+  // Links the nodes waiting on a node just added to the graph
+  void resolveDep(JSONNode node);
+  // Returns false if the node was already marked finished
+  bool markNodeFinished(uint64_t node_id);
+  bool isNodeFinished(uint64_t node_id) const;
+
+  std::unique_ptr<JSONTraceReader> reader_;
+  std::shared_ptr<JSONNodeTable> table_;
+  const int window_size_;
+  bool et_complete_{false};
+
+  std::unordered_map<uint64_t, JSONNode> dep_graph_{};
+  std::unordered_set<uint64_t> dep_free_node_id_set_{};
+  std::priority_queue<
+      JSONNode, // type of stored elements
+      std::vector<JSONNode>, // underlying container to store elements
+      CompareJSONNodesGT> // compare type providing a strick weak ordering
+      dep_free_node_queue_{};
+  std::unordered_set<JSONNode, std::hash<JSONNode>>
+      dep_unresolved_node_set_{};
+  // Reverse index from a parent node ID that has not been read yet to the
+  // nodes waiting on it
+  std::unordered_map<uint64_t, std::vector<JSONNode>>
+      dep_unresolved_child_map_{};
+  // IDs of nodes whose children have been freed, so that a node read after
+  // its parent finished does not wait on it. Dense IDs are kept in a bitmap.
+  std::vector<uint64_t> finished_node_bitmap_{};
+  std::unordered_set<uint64_t> finished_node_id_set_{};
+};
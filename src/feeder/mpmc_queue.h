@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace Chakra {
+
+// Bounded lock-free ring that any number of threads may push to and pop
+// from. Each slot carries a sequence number telling whether it is free for
+// the producer of a given lap or holds an item for its consumer, so that
+// producers and consumers only contend on their own end's position. The
+// capacity is rounded up to a power of two.
+template <typename T>
+class MPMCQueue {
+ public:
+  explicit MPMCQueue(size_t capacity)
+      : capacity_(roundUp(capacity)),
+        mask_(capacity_ - 1),
+        slots_(new Slot[capacity_]) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns false if the queue is full
+  bool push(T&& item) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[pos & mask_];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      if (sequence == pos) {
+        if (tail_.compare_exchange_weak(pos, pos + 1)) {
+          break;
+        }
+      } else if (sequence < pos) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->item = std::move(item);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the queue is empty
+  bool pop(T& item) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[pos & mask_];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      if (sequence == pos + 1) {
+        if (head_.compare_exchange_weak(pos, pos + 1)) {
+          break;
+        }
+      } else if (sequence < pos + 1) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    item = std::move(slot->item);
+    slot->sequence.store(pos + capacity_, std::memory_order_release);
+    return true;
+  }
+
+  // Exact only while no other thread uses the queue
+  size_t size() const {
+    size_t head = head_.load();
+    size_t tail = tail_.load();
+    return (tail > head) ? (tail - head) : 0;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence{0};
+    T item{};
+  };
+
+  static size_t roundUp(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    return size;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  // Producers and consumers each keep to their own cache line
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) std::atomic<size_t> head_{0};
+};
+
+} // namespace Chakra
@@ -0,0 +1,54 @@
+#include "node_slab.h"
+
+#include <algorithm>
+#include <new>
+
+using namespace std;
+using namespace Chakra;
+
+NodeSlab::NodeSlab(size_t slots_per_chunk)
+    : slots_per_chunk_(slots_per_chunk), slot_size_(0), free_list_(nullptr) {}
+
+NodeSlab::~NodeSlab() {}
+
+void* NodeSlab::allocate(size_t size) {
+  lock_guard<mutex> lock(mutex_);
+  if (slot_size_ == 0) {
+    // Round up so that every slot stays suitably aligned
+    const size_t align = alignof(max_align_t);
+    slot_size_ = ((max(size, sizeof(void*)) + align - 1) / align) * align;
+  }
+  if (size > slot_size_) {
+    return ::operator new(size);
+  }
+  if (free_list_ == nullptr) {
+    addChunk();
+  }
+  void* slot = free_list_;
+  free_list_ = *static_cast<void**>(slot);
+  return slot;
+}
+
+void NodeSlab::deallocate(void* ptr, size_t size) {
+  lock_guard<mutex> lock(mutex_);
+  if (size > slot_size_) {
+    ::operator delete(ptr);
+    return;
+  }
+  *static_cast<void**>(ptr) = free_list_;
+  free_list_ = ptr;
+}
+
+void NodeSlab::addChunk() {
+  const size_t chunk_size = slot_size_ * slots_per_chunk_;
+  chunks_.emplace_back(
+      new max_align_t[(chunk_size + sizeof(max_align_t) - 1) /
+                      sizeof(max_align_t)]);
+  char* chunk = reinterpret_cast<char*>(chunks_.back().get());
+  // Thread the new slots onto the free list, lowest address first
+  for (size_t i = slots_per_chunk_; i > 0; --i) {
+    void* slot = chunk + (i - 1) * slot_size_;
+    *static_cast<void**>(slot) = free_list_;
+    free_list_ = slot;
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Chakra {
+
+// NodeSlab hands out fixed-size slots carved from large chunks. Slots never
+// move once allocated and freed slots are reused, so objects of one type can
+// be created and destroyed without going through the global allocator. Slots
+// may be allocated and freed from different threads.
+class NodeSlab {
+ public:
+  NodeSlab(size_t slots_per_chunk = 4096);
+  ~NodeSlab();
+
+  void* allocate(size_t size);
+  void deallocate(void* ptr, size_t size);
+
+ private:
+  NodeSlab(const NodeSlab&) = delete;
+  NodeSlab& operator=(const NodeSlab&) = delete;
+
+  void addChunk();
+
+  std::mutex mutex_{};
+  const size_t slots_per_chunk_;
+  // Fixed by the first allocation; other sizes fall back to operator new
+  size_t slot_size_;
+  std::vector<std::unique_ptr<std::max_align_t[]>> chunks_{};
+  void* free_list_;
+};
+
+// Standard allocator over a shared NodeSlab, meant for std::allocate_shared
+// so that the node and its control block share a single slot
+template <typename T>
+class NodeSlabAllocator {
+ public:
+  using value_type = T;
+
+  explicit NodeSlabAllocator(std::shared_ptr<NodeSlab> slab)
+      : slab_(std::move(slab)) {}
+
+  template <typename U>
+  NodeSlabAllocator(const NodeSlabAllocator<U>& other) : slab_(other.slab_) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(slab_->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    slab_->deallocate(ptr, n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const NodeSlabAllocator<U>& other) const {
+    return slab_ == other.slab_;
+  }
+
+  template <typename U>
+  bool operator!=(const NodeSlabAllocator<U>& other) const {
+    return slab_ != other.slab_;
+  }
+
+ private:
+  template <typename U>
+  friend class NodeSlabAllocator;
+
+  std::shared_ptr<NodeSlab> slab_;
+};
+
+} // namespace Chakra
@@ -0,0 +1,76 @@
+#include "protobuf_trace_source.h"
+
+ProtobufTraceSource::ProtobufTraceSource(const std::string& filename)
+    : et_feeder_(std::make_unique<Chakra::ETFeeder>(filename)) {}
+
+ProtobufTraceSource::~ProtobufTraceSource() {}
+
+Chakra::ETFeeder& ProtobufTraceSource::feeder() {
+  return *et_feeder_;
+}
+
+void ProtobufTraceSource::addNode(std::shared_ptr<Chakra::ETFeederNode> node) {
+  et_feeder_->addNode(node);
+}
+
+void ProtobufTraceSource::removeNode(uint64_t node_id) {
+  et_feeder_->removeNode(node_id);
+}
+
+void ProtobufTraceSource::resolveDep() {
+  et_feeder_->resolveDep();
+}
+
+void ProtobufTraceSource::pushBackIssuableNode(uint64_t node_id) {
+  et_feeder_->pushBackIssuableNode(node_id);
+}
+
+void ProtobufTraceSource::freeChildrenNodes(uint64_t node_id) {
+  et_feeder_->freeChildrenNodes(node_id);
+}
+
+bool ProtobufTraceSource::hasNodesToIssue() {
+  return et_feeder_->hasNodesToIssue();
+}
+
+bool ProtobufTraceSource::getNextIssuableNode(TraceNodeFields& fields) {
+  select(et_feeder_->getNextIssuableNode(), fields);
+  return fields.node != nullptr;
+}
+
+void ProtobufTraceSource::lookupNode(
+    uint64_t node_id,
+    TraceNodeFields& fields) {
+  select(et_feeder_->lookupNode(node_id), fields);
+}
+
+// Only the ID and type are read when a node is selected, as the others go
+// through the node's attributes and many nodes are selected without being
+// issued
+void ProtobufTraceSource::readFields(TraceNodeFields& fields) const {
+  auto node = static_cast<const Chakra::ETFeederNode*>(fields.node.get());
+  if (node == nullptr) {
+    return;
+  }
+  fields.id = node->id();
+  fields.type = node->type();
+}
+
+void ProtobufTraceSource::readDetails(TraceNodeFields& fields) const {
+  auto node = static_cast<const Chakra::ETFeederNode*>(fields.node.get());
+  if (node == nullptr) {
+    return;
+  }
+  fields.has_details = true;
+  fields.name = node->name();
+  fields.is_cpu_op = node->is_cpu_op();
+  fields.runtime = node->runtime();
+  fields.num_ops = node->num_ops();
+  fields.tensor_size = node->tensor_size();
+  fields.comm_type = node->comm_type();
+  fields.comm_priority = node->comm_priority();
+  fields.comm_size = node->comm_size();
+  fields.comm_src = node->comm_src();
+  fields.comm_dst = node->comm_dst();
+  fields.comm_tag = node->comm_tag();
+}
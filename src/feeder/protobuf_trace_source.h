@@ -0,0 +1,30 @@
+#pragma once
+
+#include "et_feeder.h"
+#include "et_feeder_node.h"
+#include "trace_source.h"
+
+// Protobuf traces, fed by an ETFeeder
+class ProtobufTraceSource final
+    : public BasicTraceSource<std::shared_ptr<Chakra::ETFeederNode>> {
+ public:
+  explicit ProtobufTraceSource(const std::string& filename);
+  ~ProtobufTraceSource() override;
+
+  Chakra::ETFeeder& feeder();
+  void addNode(std::shared_ptr<Chakra::ETFeederNode> node);
+
+  void removeNode(uint64_t node_id) override;
+  void resolveDep() override;
+  void pushBackIssuableNode(uint64_t node_id) override;
+  void freeChildrenNodes(uint64_t node_id) override;
+  bool hasNodesToIssue() override;
+  bool getNextIssuableNode(TraceNodeFields& fields) override;
+  void lookupNode(uint64_t node_id, TraceNodeFields& fields) override;
+  void readDetails(TraceNodeFields& fields) const override;
+
+ private:
+  void readFields(TraceNodeFields& fields) const override;
+
+  std::unique_ptr<Chakra::ETFeeder> et_feeder_;
+};
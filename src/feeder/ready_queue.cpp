@@ -0,0 +1,131 @@
+#include "ready_queue.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace Chakra;
+
+namespace {
+struct EntryAfter {
+  template <typename Entry>
+  bool operator()(const Entry& lhs, const Entry& rhs) const {
+    return (lhs.key != rhs.key) ? (lhs.key > rhs.key) : (lhs.id > rhs.id);
+  }
+};
+
+bool isCommNode(ChakraProtoMsg::NodeType type) {
+  return (type == ChakraProtoMsg::COMM_SEND_NODE) ||
+      (type == ChakraProtoMsg::COMM_RECV_NODE) ||
+      (type == ChakraProtoMsg::COMM_COLL_NODE);
+}
+} // namespace
+
+ReadyQueue::ReadyQueue(IssuePolicy policy) : policy_(policy) {
+  if (policy_ != IssuePolicy::Fifo) {
+    buckets_.resize(kNumBuckets);
+  }
+}
+
+void ReadyQueue::push(shared_ptr<ETFeederNode> node) {
+  if (policy_ == IssuePolicy::Fifo) {
+    pushFifo(std::move(node));
+    return;
+  }
+
+  size_t bucket = 0;
+  uint64_t key = 0;
+  switch (policy_) {
+    case IssuePolicy::CommPriority:
+      bucket = kNumBuckets - 1 -
+          min<size_t>(node->comm_priority(), kNumBuckets - 1);
+      break;
+    case IssuePolicy::CriticalPath:
+      // Larger bottom levels sort first
+      key = ~static_cast<uint64_t>(
+          node->get_attr<int64_t>(AttrId::bottom_level));
+      break;
+    case IssuePolicy::CommFirst:
+      bucket = isCommNode(node->type()) ? 0 : 1;
+      break;
+    default:
+      break;
+  }
+
+  vector<Entry>& heap = buckets_[bucket];
+  heap.push_back(Entry{key, node->id(), std::move(node)});
+  push_heap(heap.begin(), heap.end(), EntryAfter());
+  non_empty_buckets_ |= 1ull << bucket;
+  ++size_;
+}
+
+void ReadyQueue::pushFront(shared_ptr<ETFeederNode> node) {
+  if (policy_ != IssuePolicy::Fifo) {
+    // Its key sorts it first again
+    push(std::move(node));
+    return;
+  }
+  if (size_ == ring_.size()) {
+    growRing();
+  }
+  ring_head_ = (ring_head_ + ring_.size() - 1) & (ring_.size() - 1);
+  ring_[ring_head_] = std::move(node);
+  ++size_;
+}
+
+shared_ptr<ETFeederNode> ReadyQueue::pop() {
+  if (size_ == 0) {
+    return nullptr;
+  }
+  if (policy_ == IssuePolicy::Fifo) {
+    return popFifo();
+  }
+
+  size_t bucket = __builtin_ctzll(non_empty_buckets_);
+  vector<Entry>& heap = buckets_[bucket];
+  pop_heap(heap.begin(), heap.end(), EntryAfter());
+  shared_ptr<ETFeederNode> node = std::move(heap.back().node);
+  heap.pop_back();
+  if (heap.empty()) {
+    non_empty_buckets_ &= ~(1ull << bucket);
+  }
+  --size_;
+  return node;
+}
+
+size_t ReadyQueue::size() const {
+  return size_;
+}
+
+bool ReadyQueue::empty() const {
+  return size_ == 0;
+}
+
+IssuePolicy ReadyQueue::policy() const {
+  return policy_;
+}
+
+void ReadyQueue::pushFifo(shared_ptr<ETFeederNode> node) {
+  if (size_ == ring_.size()) {
+    growRing();
+  }
+  ring_[(ring_head_ + size_) & (ring_.size() - 1)] = std::move(node);
+  ++size_;
+}
+
+// Unrolls the ring into a buffer twice as large. Sizes stay powers of two,
+// so that positions wrap with a mask.
+void ReadyQueue::growRing() {
+  vector<shared_ptr<ETFeederNode>> ring(max<size_t>(ring_.size() * 2, 64));
+  for (size_t i = 0; i < size_; ++i) {
+    ring[i] = std::move(ring_[(ring_head_ + i) & (ring_.size() - 1)]);
+  }
+  ring_ = std::move(ring);
+  ring_head_ = 0;
+}
+
+shared_ptr<ETFeederNode> ReadyQueue::popFifo() {
+  shared_ptr<ETFeederNode> node = std::move(ring_[ring_head_]);
+  ring_head_ = (ring_head_ + 1) & (ring_.size() - 1);
+  --size_;
+  return node;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "et_feeder_node.h"
+
+namespace Chakra {
+
+// Order in which the feeder hands out issuable nodes
+enum class IssuePolicy {
+  // Smallest node ID first
+  IdOrder,
+  // In the order the nodes became issuable
+  Fifo,
+  // Highest comm_priority first, then smallest ID. Priorities above 63
+  // share the top bucket.
+  CommPriority,
+  // Longest path to the end of the trace first, as given by the bottom_level
+  // attribute (see et_critical_path), then smallest ID. Nodes without the
+  // attribute come last.
+  CriticalPath,
+  // Communication nodes before all others, then smallest ID
+  CommFirst,
+};
+
+// Queue of issuable nodes ordered by an IssuePolicy. Sort keys are computed
+// once per push and kept next to the node, so ordering never goes through
+// the node. FIFO order uses a ring; the other policies map each node to one
+// of up to 64 buckets, served lowest first through a bitmap of non-empty
+// buckets, and order each bucket as a binary heap on (key, ID).
+class ReadyQueue {
+ public:
+  explicit ReadyQueue(IssuePolicy policy = IssuePolicy::IdOrder);
+
+  void push(std::shared_ptr<ETFeederNode> node);
+  // Puts back a node that was just popped, so that it is popped next
+  void pushFront(std::shared_ptr<ETFeederNode> node);
+  // Returns nullptr if the queue is empty
+  std::shared_ptr<ETFeederNode> pop();
+  size_t size() const;
+  bool empty() const;
+  IssuePolicy policy() const;
+
+ private:
+  struct Entry {
+    uint64_t key;
+    uint64_t id;
+    std::shared_ptr<ETFeederNode> node;
+  };
+
+  static constexpr size_t kNumBuckets = 64;
+
+  void pushFifo(std::shared_ptr<ETFeederNode> node);
+  std::shared_ptr<ETFeederNode> popFifo();
+  void growRing();
+
+  const IssuePolicy policy_;
+  size_t size_{0};
+
+  // FIFO ring, grown by doubling
+  std::vector<std::shared_ptr<ETFeederNode>> ring_{};
+  size_t ring_head_{0};
+
+  std::vector<std::vector<Entry>> buckets_{};
+  uint64_t non_empty_buckets_{0};
+};
+
+} // namespace Chakra
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Chakra {
+
+// Bounded lock-free ring for handing items from one producer thread to one
+// consumer thread. push() must only be called by the producer and pop() only
+// by the consumer; neither blocks.
+template <typename T>
+class SPSCQueue {
+ public:
+  explicit SPSCQueue(size_t capacity) : buffer_(capacity + 1) {}
+
+  // Returns false if the queue is full
+  bool push(T&& item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t next = advance(tail);
+    if (next == head_.load()) {
+      return false;
+    }
+    buffer_[tail] = std::move(item);
+    tail_.store(next);
+    return true;
+  }
+
+  // Returns false if the queue is empty
+  bool pop(T& item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load()) {
+      return false;
+    }
+    item = std::move(buffer_[head]);
+    head_.store(advance(head));
+    return true;
+  }
+
+  size_t size() const {
+    size_t head = head_.load();
+    size_t tail = tail_.load();
+    return (tail >= head) ? (tail - head) : (tail + buffer_.size() - head);
+  }
+
+ private:
+  size_t advance(size_t index) const {
+    return (index + 1 == buffer_.size()) ? 0 : index + 1;
+  }
+
+  std::vector<T> buffer_;
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+};
+
+} // namespace Chakra
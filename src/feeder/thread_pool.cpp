@@ -0,0 +1,53 @@
+#include "thread_pool.h"
+
+using namespace std;
+using namespace Chakra;
+
+ThreadPool::ThreadPool(size_t num_threads) : stop_(false) {
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+future<void> ThreadPool::submit(function<void()> task) {
+  packaged_task<void()> packaged(std::move(task));
+  future<void> result = packaged.get_future();
+  {
+    lock_guard<mutex> lock(mutex_);
+    tasks_.emplace(std::move(packaged));
+  }
+  cv_.notify_one();
+  return result;
+}
+
+size_t ThreadPool::size() const {
+  return workers_.size();
+}
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    packaged_task<void()> task;
+    {
+      unique_lock<mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+      // Drain the remaining tasks before stopping
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    task();
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Chakra {
+
+// Fixed set of worker threads running submitted tasks in submission order.
+// A pool can be shared by several feeders.
+class ThreadPool {
+ public:
+  ThreadPool(size_t num_threads);
+  ~ThreadPool();
+
+  std::future<void> submit(std::function<void()> task);
+  size_t size() const;
+
+ private:
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void workerLoop();
+
+  std::vector<std::thread> workers_{};
+  std::queue<std::packaged_task<void()>> tasks_{};
+  std::mutex mutex_{};
+  std::condition_variable cv_{};
+  bool stop_;
+};
+
+} // namespace Chakra
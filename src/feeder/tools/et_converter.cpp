@@ -0,0 +1,50 @@
+// Converts Chakra traces to the protobuf format the feeder reads fastest.
+//
+//   et_converter <trace.json> <output>
+//   et_converter [--topological] <trace> <output>
+//
+// A JSON trace is streamed into a protobuf trace; a protobuf trace is copied,
+// in topological order if asked to. The output is compressed as its name
+// says: <output>.gz with gzip, <output>.zb in independently compressed
+// blocks, and not compressed otherwise.
+
+#include <cstring>
+#include <iostream>
+
+#include "et_converter.h"
+
+using namespace std;
+using namespace Chakra;
+
+int main(int argc, char** argv) {
+  const bool topological =
+      (argc == 4) && (strcmp(argv[1], "--topological") == 0);
+  if (argc != 3 && !topological) {
+    cerr << "Usage: " << argv[0] << " <trace.json> <output>" << endl
+         << "       " << argv[0] << " [--topological] <trace> <output>"
+         << endl;
+    return 1;
+  }
+  const string trace_filename = argv[topological ? 2 : 1];
+  const string output_filename = argv[topological ? 3 : 2];
+  const bool is_json = (trace_filename.size() >= 5) &&
+      (trace_filename.compare(trace_filename.size() - 5, 5, ".json") == 0);
+  if (is_json && topological) {
+    cerr << "Error: --topological only applies to protobuf traces" << endl;
+    return 1;
+  }
+
+  try {
+    uint64_t num_nodes = is_json
+        ? convertJSONTrace(trace_filename, output_filename)
+        : reencodeTrace(
+              trace_filename,
+              output_filename,
+              topological ? TraceOrder::Topological : TraceOrder::Input);
+    cout << "Wrote " << num_nodes << " nodes to " << output_filename << endl;
+  } catch (const exception& e) {
+    cerr << "Error: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,34 @@
+// Builds the sidecar index of a Chakra trace, so that ETFeeder and analysis
+// tools can fetch any node without reading the trace up to it.
+//
+//   et_indexer <trace> [<index>]
+//
+// The index is written to <trace>.etidx unless a path is given.
+
+#include <iostream>
+
+#include "et_index.h"
+
+using namespace std;
+using namespace Chakra;
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    cerr << "Usage: " << argv[0] << " <trace> [<index>]" << endl;
+    return 1;
+  }
+  const string trace_filename = argv[1];
+  const string index_filename =
+      (argc == 3) ? argv[2] : ETIndex::defaultFilename(trace_filename);
+
+  try {
+    unique_ptr<ETIndex> index = ETIndex::build(trace_filename);
+    index->write(index_filename, trace_filename);
+    cout << "Indexed " << index->size() << " nodes into " << index_filename
+         << endl;
+  } catch (const exception& e) {
+    cerr << "Error: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <string>
+
+// Fields of the node a trace source has selected, so that reading them is a
+// member access whatever the trace format is. The ID and type are copied out
+// when the node is selected. A backend whose other fields are costly to read
+// leaves them to TraceSource::readDetails, which WrapperNode calls the first
+// time one of them is read.
+struct TraceNodeFields {
+  uint64_t id{0};
+  int type{0};
+  // Handle to the backend node, kept with the fields so that a later
+  // selection through a copy of the WrapperNode does not change the node
+  // they were read from. BasicTraceSource::node casts it back.
+  std::shared_ptr<const void> node{nullptr};
+  bool has_details{false};
+  std::string name{};
+  bool is_cpu_op{false};
+  uint64_t runtime{0};
+  uint64_t num_ops{0};
+  uint64_t tensor_size{0};
+  int64_t comm_type{0};
+  uint32_t comm_priority{0};
+  uint64_t comm_size{0};
+  uint32_t comm_src{0};
+  uint32_t comm_dst{0};
+  uint32_t comm_tag{0};
+};
+
+// Dependency graph of a trace, whatever its format. WrapperNode picks a
+// backend once when it opens a trace and then makes one virtual call per
+// graph operation or node selection; the fields of the selected node are
+// read from a TraceNodeFields. The backends are final, so a simulator that
+// is templated on the backend type gets the same calls statically
+// dispatched. A new format plugs in by deriving from BasicTraceSource and
+// adding a case to WrapperNode::createWrapper.
+class TraceSource {
+ public:
+  virtual ~TraceSource() = default;
+
+  virtual void removeNode(uint64_t node_id) = 0;
+  virtual void resolveDep() = 0;
+  virtual void pushBackIssuableNode(uint64_t node_id) = 0;
+  virtual void freeChildrenNodes(uint64_t node_id) = 0;
+  virtual bool hasNodesToIssue() = 0;
+
+  // Select a node and fill in its fields. getNextIssuableNode returns false
+  // once no node is issuable, and lookupNode throws std::out_of_range if
+  // the node has not been read yet.
+  virtual bool getNextIssuableNode(TraceNodeFields& fields) = 0;
+  virtual void lookupNode(uint64_t node_id, TraceNodeFields& fields) = 0;
+  // Fills in the fields after the ID and type of a selected node, for the
+  // backends that do not set has_details when selecting it
+  virtual void readDetails(TraceNodeFields& /*fields*/) const {}
+
+  // Queue of selected nodes put aside by the simulator
+  virtual void pushToQueue(const TraceNodeFields& fields) = 0;
+  virtual bool isQueueEmpty() const = 0;
+  // Selects the node at the front of the queue
+  virtual void queueFront(TraceNodeFields& fields) = 0;
+  virtual void popFromQueue() = 0;
+};
+
+// Type erases the node handles of a backend for TraceNodeFields::node
+template <typename Node>
+struct TraceNodeHandle {
+  static std::shared_ptr<const void> wrap(Node node) {
+    return std::make_shared<const Node>(std::move(node));
+  }
+  static Node unwrap(const std::shared_ptr<const void>& handle) {
+    return handle ? *static_cast<const Node*>(handle.get()) : Node{};
+  }
+};
+
+// Handles that are shared pointers already are kept as they are
+template <typename T>
+struct TraceNodeHandle<std::shared_ptr<T>> {
+  static std::shared_ptr<const void> wrap(std::shared_ptr<T> node) {
+    return node;
+  }
+  static std::shared_ptr<T> unwrap(const std::shared_ptr<const void>& handle) {
+    return std::const_pointer_cast<T>(
+        std::static_pointer_cast<const T>(handle));
+  }
+};
+
+// Keeps the queue of put aside nodes for a backend whose nodes are handles
+// of type Node
+template <typename Node>
+class BasicTraceSource : public TraceSource {
+ public:
+  // Node the fields were selected from
+  static Node node(const TraceNodeFields& fields) {
+    return TraceNodeHandle<Node>::unwrap(fields.node);
+  }
+
+  void pushToQueue(const TraceNodeFields& fields) override {
+    push_back_queue_.push(node(fields));
+  }
+
+  bool isQueueEmpty() const override {
+    return push_back_queue_.empty();
+  }
+
+  void queueFront(TraceNodeFields& fields) override {
+    select(push_back_queue_.front(), fields);
+  }
+
+  void popFromQueue() override {
+    push_back_queue_.pop();
+  }
+
+ protected:
+  void select(Node node, TraceNodeFields& fields) {
+    fields.node = TraceNodeHandle<Node>::wrap(std::move(node));
+    fields.has_details = false;
+    readFields(fields);
+  }
+  // Copies the fields of the selected node, at least its ID and type
+  virtual void readFields(TraceNodeFields& fields) const = 0;
+
+ private:
+  std::queue<Node> push_back_queue_{};
+};
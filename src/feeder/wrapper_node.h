@@ -1,51 +1,46 @@
 #pragma once
 
-#include "et_feeder.h"
-#include "et_feeder_node.h"
-#include "json_node.h"
+#include "json_trace_source.h"
+#include "protobuf_trace_source.h"
 
 using json = nlohmann::json;
 
 enum format { Protobuf, JSON };
 
 // WrapperNode class wraps protobuf and JSON
+// The backend for the format of the trace is picked once when it is opened,
+// and the fields of a node are copied out once, when it is selected or when
+// the first of them is read, so the getters do not depend on the format.
 class WrapperNode {
  private:
   enum format format_type_;
-  Chakra::ETFeeder* et_feeder_;
-  std::shared_ptr<Chakra::ETFeederNode> node_{nullptr};
-  std::ifstream jsonfile_;
-  json data_;
-  JSONNode json_node_;
-  int64_t node_idx_ = -1;
-  std::queue<std::shared_ptr<Chakra::ETFeederNode>> push_back_queue_proto;
-  std::queue<JSONNode> push_back_queue_json;
-  std::unordered_map<uint64_t, JSONNode> dep_graph_json{};
-  std::unordered_set<uint64_t> dep_free_node_id_set_json{};
-  std::priority_queue<
-      JSONNode, // type of stored elements
-      std::vector<JSONNode>, // underlying container to store elements
-      CompareJSONNodesGT> // compare type providing a strick weak ordering
-      dep_free_node_queue_json{};
-  std::unordered_set<JSONNode, std::hash<JSONNode>>
-      dep_unresolved_node_set_json{};
-  int window_size_json;
-  bool json_et_complete_;
+  std::shared_ptr<TraceSource> source_{nullptr};
+  // Fields of the selected node
+  TraceNodeFields fields_{};
+  bool valid_node_{false};
+
+  // Backend of a given format, for the calls that depend on it
+  ProtobufTraceSource& protobufSource();
+  JSONTraceSource& jsonSource();
+  // Fields of the selected node, with the ones the backend reads lazily
+  const TraceNodeFields& details();
 
  public:
   WrapperNode();
   WrapperNode(const WrapperNode& t);
-  WrapperNode(std::string filename);
+  // JSON traces are read in windows of at least json_window_size nodes
+  WrapperNode(std::string filename, int json_window_size = 4096 * 256);
   ~WrapperNode();
   void releaseMemory();
-  void createWrapper(std::string filename);
+  void createWrapper(std::string filename, int json_window_size = 4096 * 256);
   std::shared_ptr<Chakra::ETFeederNode> getProtobufNode();
   JSONNode getJSONNode();
   void addNode(JSONNode node);
   void addNode(std::shared_ptr<Chakra::ETFeederNode> node);
   void removeNode(uint64_t node_id);
   void readNextWindow();
-  JSONNode readNode(uint64_t node_id);
+  // Reads the next JSON node, returning false after the last one
+  bool readNode(JSONNode& node);
   void resolveDep();
   void pushBackIssuableNode(uint64_t node_id);
   void freeChildrenNodes(uint64_t node_id);
@@ -0,0 +1,423 @@
+/**
+ * @file
+ * Definition of zero-copy streams for block-compressed traces.
+ */
+
+#include "blockio.hh"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+/// Size of a block header and of the end marker
+const size_t blockHeaderSize = 3 * sizeof(uint32_t);
+
+/// Size of the footer at the very end of the container
+const size_t footerSize = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+/// Size of a block table entry
+const size_t tableEntrySize = 3 * sizeof(uint64_t);
+
+void putUint32(std::string& out, uint32_t value) {
+  for (int i = 0; i < 4; ++i)
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+void putUint64(std::string& out, uint64_t value) {
+  for (int i = 0; i < 8; ++i)
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+uint32_t getUint32(const unsigned char* in) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i)
+    value |= static_cast<uint32_t>(in[i]) << (8 * i);
+  return value;
+}
+
+uint64_t getUint64(const unsigned char* in) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i)
+    value |= static_cast<uint64_t>(in[i]) << (8 * i);
+  return value;
+}
+
+std::string inflateBlock(const std::string& compressed, uint32_t size) {
+  std::string out(size, '\0');
+  uLongf outSize = size;
+  int ret = uncompress(
+      reinterpret_cast<Bytef*>(&out[0]),
+      &outSize,
+      reinterpret_cast<const Bytef*>(compressed.data()),
+      compressed.size());
+  if (ret != Z_OK || outSize != size)
+    throw std::runtime_error("Corrupted block in block-compressed trace");
+  return out;
+}
+
+} // namespace
+
+bool BlockStream::isBlockFile(const unsigned char* bytes) {
+  return getUint32(bytes) == magicNumber;
+}
+
+BlockOutputStream::BlockOutputStream(
+    std::ostream* output,
+    uint32_t messagesPerBlock,
+    int level)
+    : output(output),
+      messagesPerBlock(std::max<uint32_t>(messagesPerBlock, 1)),
+      level(level),
+      bufferUsed(0),
+      blockMessages(0),
+      totalMessages(0),
+      totalBytes(0),
+      fileOffset(0),
+      closed(false) {
+  std::string header;
+  putUint32(header, magicNumber);
+  putUint32(header, version);
+  putUint32(header, this->messagesPerBlock);
+  output->write(header.data(), header.size());
+  fileOffset = header.size();
+}
+
+BlockOutputStream::~BlockOutputStream() {
+  close();
+}
+
+bool BlockOutputStream::Next(void** data, int* size) {
+  // Hand out at least this many fresh bytes at a time
+  const size_t minFree = 8192;
+  if (buffer.size() - bufferUsed < minFree)
+    buffer.resize(std::max(buffer.size() * 2, bufferUsed + minFree));
+
+  *data = &buffer[bufferUsed];
+  *size = static_cast<int>(buffer.size() - bufferUsed);
+  totalBytes += buffer.size() - bufferUsed;
+  bufferUsed = buffer.size();
+  return true;
+}
+
+void BlockOutputStream::BackUp(int count) {
+  bufferUsed -= count;
+  totalBytes -= count;
+}
+
+int64_t BlockOutputStream::ByteCount() const {
+  return totalBytes;
+}
+
+void BlockOutputStream::endMessage() {
+  ++blockMessages;
+  ++totalMessages;
+  if (blockMessages >= messagesPerBlock)
+    flushBlock();
+}
+
+void BlockOutputStream::flushBlock() {
+  if (bufferUsed == 0)
+    return;
+
+  uLongf compressedSize = compressBound(bufferUsed);
+  std::string compressed(compressedSize, '\0');
+  int ret = compress2(
+      reinterpret_cast<Bytef*>(&compressed[0]),
+      &compressedSize,
+      reinterpret_cast<const Bytef*>(buffer.data()),
+      bufferUsed,
+      level);
+  if (ret != Z_OK)
+    throw std::runtime_error("Unable to compress block of trace");
+
+  BlockInfo info;
+  info.fileOffset = fileOffset;
+  info.firstMessage = totalMessages - blockMessages;
+  info.uncompressedOffset = totalBytes - bufferUsed;
+  blocks.push_back(info);
+
+  std::string header;
+  putUint32(header, static_cast<uint32_t>(compressedSize));
+  putUint32(header, static_cast<uint32_t>(bufferUsed));
+  putUint32(header, blockMessages);
+  output->write(header.data(), header.size());
+  output->write(compressed.data(), compressedSize);
+  fileOffset += header.size() + compressedSize;
+
+  bufferUsed = 0;
+  blockMessages = 0;
+}
+
+void BlockOutputStream::close() {
+  if (closed)
+    return;
+  closed = true;
+
+  flushBlock();
+
+  std::string tail(blockHeaderSize, '\0');
+  uint64_t tableOffset = fileOffset + tail.size();
+  for (const auto& info : blocks) {
+    putUint64(tail, info.fileOffset);
+    putUint64(tail, info.firstMessage);
+    putUint64(tail, info.uncompressedOffset);
+  }
+  putUint64(tail, tableOffset);
+  putUint32(tail, static_cast<uint32_t>(blocks.size()));
+  putUint32(tail, magicNumber);
+  output->write(tail.data(), tail.size());
+  output->flush();
+}
+
+BlockInputStream::BlockInputStream(std::istream* input, int readAhead)
+    : input(input),
+      readAhead(std::max(readAhead, 0)),
+      inputDone(false),
+      position(0),
+      currentIndex(0),
+      nextIndex(0),
+      blockStart(0),
+      compressedBytes(blockHeaderSize),
+      tableLoaded(false),
+      stopping(false) {
+  unsigned char header[blockHeaderSize];
+  input->read(reinterpret_cast<char*>(header), sizeof(header));
+  if (!input->good() || !isBlockFile(header) ||
+      getUint32(header + 4) != version)
+    throw std::runtime_error("Not a block-compressed trace");
+}
+
+BlockInputStream::~BlockInputStream() {
+  clearReadAhead();
+  {
+    std::lock_guard<std::mutex> lock(taskMutex);
+    stopping = true;
+  }
+  taskReady.notify_all();
+  for (auto& worker : workers)
+    worker.join();
+}
+
+std::future<std::string> BlockInputStream::inflateAsync(
+    std::string compressed,
+    uint32_t size) {
+  std::packaged_task<std::string()> task(
+      [compressed = std::move(compressed), size]() {
+        return inflateBlock(compressed, size);
+      });
+  std::future<std::string> block = task.get_future();
+  {
+    std::lock_guard<std::mutex> lock(taskMutex);
+    tasks.push_back(std::move(task));
+  }
+  if (workers.empty()) {
+    // A stream that is read without read ahead still decompresses off
+    // the reading thread, one block at a time
+    for (int i = 0; i < std::max(readAhead, 1); ++i)
+      workers.emplace_back(&BlockInputStream::workerLoop, this);
+  }
+  taskReady.notify_one();
+  return block;
+}
+
+void BlockInputStream::workerLoop() {
+  while (true) {
+    std::packaged_task<std::string()> task;
+    {
+      std::unique_lock<std::mutex> lock(taskMutex);
+      taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (tasks.empty())
+        return;
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    // Errors reach the reader through the future
+    task();
+  }
+}
+
+bool BlockInputStream::readAheadBlock() {
+  if (inputDone)
+    return false;
+
+  unsigned char header[blockHeaderSize];
+  input->read(reinterpret_cast<char*>(header), sizeof(header));
+  uint32_t compressedSize = getUint32(header);
+  uint32_t size = getUint32(header + 4);
+  if (!input->good() || (compressedSize == 0 && size == 0)) {
+    inputDone = true;
+    return false;
+  }
+
+  std::string compressed(compressedSize, '\0');
+  input->read(&compressed[0], compressedSize);
+  if (!input->good())
+    throw std::runtime_error("Truncated block in block-compressed trace");
+  compressedBytes += sizeof(header) + compressedSize;
+
+  pending.push_back(inflateAsync(std::move(compressed), size));
+  ++nextIndex;
+  return true;
+}
+
+bool BlockInputStream::nextBlock() {
+  if (pending.empty() && !readAheadBlock())
+    return false;
+
+  blockStart += current.size();
+  current = pending.front().get();
+  pending.pop_front();
+  position = 0;
+  currentIndex = nextIndex - pending.size() - 1;
+
+  // Keep the following blocks decompressing in the background
+  while (pending.size() < static_cast<size_t>(readAhead) && readAheadBlock())
+    ;
+  return true;
+}
+
+void BlockInputStream::clearReadAhead() {
+  for (auto& block : pending)
+    block.wait();
+  pending.clear();
+}
+
+bool BlockInputStream::Next(const void** data, int* size) {
+  while (position == current.size()) {
+    if (!nextBlock())
+      return false;
+  }
+  *data = current.data() + position;
+  *size = static_cast<int>(current.size() - position);
+  position = current.size();
+  return true;
+}
+
+void BlockInputStream::BackUp(int count) {
+  position -= count;
+}
+
+bool BlockInputStream::Skip(int count) {
+  while (count > 0) {
+    size_t available = current.size() - position;
+    if (available == 0) {
+      if (!nextBlock())
+        return false;
+      continue;
+    }
+    size_t step = std::min(available, static_cast<size_t>(count));
+    position += step;
+    count -= step;
+  }
+  return true;
+}
+
+int64_t BlockInputStream::ByteCount() const {
+  return blockStart + position;
+}
+
+uint64_t BlockInputStream::compressedByteCount() const {
+  return compressedBytes;
+}
+
+void BlockInputStream::loadBlockTable() {
+  if (tableLoaded)
+    return;
+
+  // Blocks are read sequentially from the input, so come back to where
+  // the next one starts once the table has been read
+  input->clear();
+  std::streampos resume = input->tellg();
+
+  unsigned char footer[footerSize];
+  input->seekg(-static_cast<std::streamoff>(footerSize), std::ios::end);
+  input->read(reinterpret_cast<char*>(footer), sizeof(footer));
+  if (!input->good() || getUint32(footer + 12) != magicNumber)
+    throw std::runtime_error("Missing block table in block-compressed trace");
+
+  uint64_t tableOffset = getUint64(footer);
+  uint32_t count = getUint32(footer + 8);
+  std::string table(count * tableEntrySize, '\0');
+  input->seekg(tableOffset);
+  input->read(&table[0], table.size());
+  if (!input->good())
+    throw std::runtime_error("Truncated block table in block-compressed trace");
+
+  const unsigned char* entry =
+      reinterpret_cast<const unsigned char*>(table.data());
+  for (uint32_t i = 0; i < count; ++i, entry += tableEntrySize) {
+    BlockInfo info;
+    info.fileOffset = getUint64(entry);
+    info.firstMessage = getUint64(entry + 8);
+    info.uncompressedOffset = getUint64(entry + 16);
+    blocks.push_back(info);
+  }
+  tableLoaded = true;
+
+  input->clear();
+  input->seekg(resume);
+}
+
+uint64_t BlockInputStream::numBlocks() {
+  loadBlockTable();
+  return blocks.size();
+}
+
+uint64_t BlockInputStream::blockFirstMessage(uint64_t block) {
+  loadBlockTable();
+  return blocks.at(block).firstMessage;
+}
+
+bool BlockInputStream::seekBlock(uint64_t block) {
+  loadBlockTable();
+  if (block >= blocks.size())
+    return false;
+
+  clearReadAhead();
+  input->clear();
+  input->seekg(blocks[block].fileOffset);
+  inputDone = false;
+  current.clear();
+  position = 0;
+  currentIndex = block;
+  nextIndex = block;
+  blockStart = blocks[block].uncompressedOffset;
+  return true;
+}
+
+bool BlockInputStream::seek(uint64_t offset) {
+  loadBlockTable();
+
+  // Find the last block starting at or before the offset
+  auto next = std::upper_bound(
+      blocks.begin(),
+      blocks.end(),
+      offset,
+      [](uint64_t offset, const BlockInfo& info) {
+        return offset < info.uncompressedOffset;
+      });
+  if (next == blocks.begin())
+    return offset == 0;
+  uint64_t block = (next - blocks.begin()) - 1;
+  if (!seekBlock(block))
+    return false;
+
+  // A block holds less than 4GB, but Skip() only takes an int
+  uint64_t remaining = offset - blocks[block].uncompressedOffset;
+  while (remaining > 0) {
+    int step = static_cast<int>(
+        std::min<uint64_t>(remaining, std::numeric_limits<int>::max()));
+    if (!Skip(step))
+      return false;
+    remaining -= step;
+  }
+  return true;
+}
+
+uint64_t BlockInputStream::currentBlock() const {
+  return currentIndex;
+}
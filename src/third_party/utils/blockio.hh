@@ -0,0 +1,266 @@
+/**
+ * @file
+ * Declaration of zero-copy streams for block-compressed traces.
+ *
+ * A block-compressed trace holds the same length-prefixed messages as
+ * a plain trace, grouped into blocks of a fixed number of messages.
+ * Each block is deflated on its own, so blocks can be decompressed in
+ * parallel and any block can be read without decompressing the ones
+ * before it. The layout is:
+ *
+ *   header:   magic, version, messages per block      (3 x uint32)
+ *   block:    compressed size, uncompressed size,
+ *             number of messages                       (3 x uint32)
+ *             deflated message bytes
+ *   ...
+ *   end:      a block header with every field zero
+ *   table:    per block, file offset, first message,
+ *             uncompressed offset                      (3 x uint64)
+ *   footer:   table offset (uint64), number of blocks,
+ *             magic                                    (2 x uint32)
+ *
+ * All integers are little endian.
+ */
+
+#ifndef __PROTO_BLOCKIO_HH__
+#define __PROTO_BLOCKIO_HH__
+
+#include <google/protobuf/io/zero_copy_stream.h>
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Constants and helpers shared by the block input and output streams.
+ */
+class BlockStream {
+ public:
+  /// The ASCII characters CHBK, read as a little-endian integer
+  static const uint32_t magicNumber = 0x4b424843;
+
+  /// Version of the container layout
+  static const uint32_t version = 1;
+
+  /// Default number of messages per block
+  static const uint32_t defaultMessagesPerBlock = 4096;
+
+  /**
+   * Check whether the first bytes of a file are the container magic.
+   *
+   * @param bytes At least four bytes from the start of the file
+   */
+  static bool isBlockFile(const unsigned char* bytes);
+
+ protected:
+  /// Location of one block, as stored in the table
+  struct BlockInfo {
+    uint64_t fileOffset;
+    uint64_t firstMessage;
+    uint64_t uncompressedOffset;
+  };
+};
+
+/**
+ * A BlockOutputStream deflates what is written to it one block at a
+ * time. The owner calls endMessage() after each message so that blocks
+ * only ever hold whole messages, and close() once everything has been
+ * written.
+ */
+class BlockOutputStream : public google::protobuf::io::ZeroCopyOutputStream,
+                          public BlockStream {
+ public:
+  /**
+   * @param output Stream the container is written to
+   * @param messagesPerBlock Number of messages in every full block
+   * @param level zlib compression level
+   */
+  BlockOutputStream(
+      std::ostream* output,
+      uint32_t messagesPerBlock = defaultMessagesPerBlock,
+      int level = -1);
+
+  /**
+   * Close the container if close() has not been called.
+   */
+  ~BlockOutputStream() override;
+
+  bool Next(void** data, int* size) override;
+  void BackUp(int count) override;
+  int64_t ByteCount() const override;
+
+  /**
+   * Mark the end of a message, flushing the block once it is full.
+   */
+  void endMessage();
+
+  /**
+   * Flush the last block and write the block table and footer.
+   */
+  void close();
+
+ private:
+  /**
+   * Compress the buffered messages and write them out as a block.
+   */
+  void flushBlock();
+
+  std::ostream* output;
+  const uint32_t messagesPerBlock;
+  const int level;
+
+  /// Uncompressed bytes of the block being filled
+  std::string buffer;
+
+  /// Bytes of the buffer in use, the rest was handed out by Next()
+  size_t bufferUsed;
+
+  uint32_t blockMessages;
+  uint64_t totalMessages;
+  uint64_t totalBytes;
+  uint64_t fileOffset;
+  std::vector<BlockInfo> blocks;
+  bool closed;
+};
+
+/**
+ * A BlockInputStream presents the messages of a block-compressed trace
+ * as one uncompressed stream. The blocks following the current one are
+ * decompressed ahead of time on other threads.
+ */
+class BlockInputStream : public google::protobuf::io::ZeroCopyInputStream,
+                         public BlockStream {
+ public:
+  /**
+   * @param input Stream positioned at the start of the container
+   * @param readAhead Number of blocks to decompress ahead of time
+   */
+  BlockInputStream(std::istream* input, int readAhead = 2);
+
+  ~BlockInputStream() override;
+
+  bool Next(const void** data, int* size) override;
+  void BackUp(int count) override;
+  bool Skip(int count) override;
+  int64_t ByteCount() const override;
+
+  /**
+   * Get the number of blocks, loading the block table if needed.
+   */
+  uint64_t numBlocks();
+
+  /**
+   * Get the index of the first message stored in a block.
+   */
+  uint64_t blockFirstMessage(uint64_t block);
+
+  /**
+   * Continue reading from the start of a block.
+   *
+   * @param block Index of the block
+   * @param return True if the block exists
+   */
+  bool seekBlock(uint64_t block);
+
+  /**
+   * Continue reading from an offset in the uncompressed stream, as
+   * given by ByteCount().
+   *
+   * @param offset Offset in the uncompressed stream
+   * @param return True if the offset is within the stream
+   */
+  bool seek(uint64_t offset);
+
+  /**
+   * Get the index of the block the next byte will be read from.
+   */
+  uint64_t currentBlock() const;
+
+  /**
+   * Get the number of bytes read from the input so far, including
+   * blocks read ahead, headers, and blocks read again after a seek.
+   */
+  uint64_t compressedByteCount() const;
+
+ private:
+  /**
+   * Read the next compressed block from the input and queue its
+   * decompression.
+   *
+   * @param return False once the end of the blocks is reached
+   */
+  bool readAheadBlock();
+
+  /**
+   * Make the next decompressed block the current one.
+   *
+   * @param return False if there are no more blocks
+   */
+  bool nextBlock();
+
+  /**
+   * Wait for the queued blocks and forget them.
+   */
+  void clearReadAhead();
+
+  /**
+   * Read the block table from the end of the container.
+   */
+  void loadBlockTable();
+
+  /**
+   * Queue the decompression of a block on the workers, starting them
+   * the first time.
+   *
+   * @param compressed Compressed bytes of the block
+   * @param size Size of the block once decompressed
+   */
+  std::future<std::string> inflateAsync(std::string compressed, uint32_t size);
+
+  /**
+   * Run queued decompressions until the stream is destroyed.
+   */
+  void workerLoop();
+
+  std::istream* input;
+  const int readAhead;
+
+  /// Blocks being decompressed, in file order
+  std::deque<std::future<std::string>> pending;
+
+  /// The input has reached the end of the blocks
+  bool inputDone;
+
+  /// Decompressed bytes of the current block and the read position
+  std::string current;
+  size_t position;
+
+  /// Index of the current block, and of the next one to be queued
+  uint64_t currentIndex;
+  uint64_t nextIndex;
+
+  /// Uncompressed bytes before the current block
+  uint64_t blockStart;
+
+  /// Bytes read from the input
+  uint64_t compressedBytes;
+
+  std::vector<BlockInfo> blocks;
+  bool tableLoaded;
+
+  /// Decompression workers, one per block read ahead, which live as
+  /// long as the stream rather than one thread per block
+  std::vector<std::thread> workers;
+  std::deque<std::packaged_task<std::string()>> tasks;
+  std::mutex taskMutex;
+  std::condition_variable taskReady;
+  bool stopping;
+};
+
+#endif //__PROTO_BLOCKIO_HH__
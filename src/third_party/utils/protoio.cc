@@ -37,6 +37,13 @@
 
 #include "protoio.hh"
 
+#include <fcntl.h>
+#include <algorithm>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #define panic(format, args...)
 
 using namespace google::protobuf;
@@ -47,16 +54,28 @@ ProtoOutputStream::ProtoOutputStream(const std::string& filename)
           std::ios::out | std::ios::binary | std::ios::trunc),
       wrappedFileStream(NULL),
       gzipStream(NULL),
+      blockStream(NULL),
       zeroCopyStream(NULL) {
   if (!fileStream.good())
     panic("Could not open %s for writing\n", filename);
 
+  std::string extension;
+  if (filename.find_last_of('.') != std::string::npos)
+    extension = filename.substr(filename.find_last_of('.') + 1);
+
+  // A block container compresses and frames the data itself, so it
+  // writes to the file stream directly
+  if (extension == "zb") {
+    blockStream = new BlockOutputStream(&fileStream);
+    zeroCopyStream = blockStream;
+    return;
+  }
+
   // Wrap the output file in a zero copy stream, that in turn is
   // wrapped in a gzip stream if the filename ends with .gz. The
   // latter stream is in turn wrapped in a coded stream
   wrappedFileStream = new io::OstreamOutputStream(&fileStream);
-  if (filename.find_last_of('.') != std::string::npos &&
-      filename.substr(filename.find_last_of('.') + 1) == "gz") {
+  if (extension == "gz") {
     gzipStream = new io::GzipOutputStream(wrappedFileStream);
     zeroCopyStream = gzipStream;
   } else {
@@ -68,55 +87,153 @@ ProtoOutputStream::~ProtoOutputStream() {
   // As the compression is optional, see if the stream exists
   if (gzipStream != NULL)
     delete gzipStream;
+  if (blockStream != NULL)
+    delete blockStream;
   delete wrappedFileStream;
   fileStream.close();
 }
 
 void ProtoOutputStream::write(const Message& msg) {
-  // Due to the byte limit of the coded stream we create it for
-  // every single mesage (based on forum discussions around the size
-  // limitation)
-  io::CodedOutputStream codedStream(zeroCopyStream);
+  {
+    // Due to the byte limit of the coded stream we create it for
+    // every single mesage (based on forum discussions around the size
+    // limitation)
+    io::CodedOutputStream codedStream(zeroCopyStream);
 
-  // Write the size of the message to the stream
+    // Write the size of the message to the stream
 #if GOOGLE_PROTOBUF_VERSION < 3001000
-  auto msg_size = msg.ByteSize();
+    auto msg_size = msg.ByteSize();
 #else
-  auto msg_size = msg.ByteSizeLong();
+    auto msg_size = msg.ByteSizeLong();
 #endif
-  codedStream.WriteVarint32(msg_size);
+    codedStream.WriteVarint32(msg_size);
+
+    // Write the message itself to the stream
+    msg.SerializeWithCachedSizes(&codedStream);
+  }
+
+  // The coded stream has handed back its unused bytes, so the block
+  // ends exactly at the message boundary
+  if (blockStream != NULL)
+    blockStream->endMessage();
+}
+
+void ProtoOutputStream::writeRecord(const std::string& record) {
+  {
+    // Same framing as write(), with the bytes copied as they are
+    io::CodedOutputStream codedStream(zeroCopyStream);
+    codedStream.WriteVarint32(record.size());
+    codedStream.WriteString(record);
+  }
+
+  if (blockStream != NULL)
+    blockStream->endMessage();
+}
 
-  // Write the message itself to the stream
-  msg.SerializeWithCachedSizes(&codedStream);
+uint64_t ProtoOutputStream::tell() const {
+  // Coded streams hand their unused bytes back when they go away, so
+  // the byte count is exactly what has been written
+  return zeroCopyStream->ByteCount();
 }
 
-ProtoInputStream::ProtoInputStream(const std::string& filename)
+// std::min takes its arguments by reference, so the constant needs a
+// definition
+const size_t ProtoInputStream::mappedChunkSize;
+
+ProtoInputStream::ProtoInputStream(const std::string& filename, bool useMmap)
     : fileStream(filename.c_str(), std::ios::in | std::ios::binary),
       fileName(filename),
       useGzip(false),
+      useMmap(useMmap),
       wrappedFileStream(NULL),
       gzipStream(NULL),
-      zeroCopyStream(NULL) {
+      useBlocks(false),
+      blockStream(NULL),
+      mappedData(NULL),
+      mappedSize(0),
+      concatStream(NULL),
+      zeroCopyStream(NULL),
+      streamStart(0),
+      suspended(false),
+      suspendedOffset(0) {
   if (!fileStream.good())
     panic("Could not open %s for reading\n", filename);
 
-  // check the magic number to see if this is a gzip stream
-  unsigned char bytes[2];
-  fileStream.read((char*)bytes, 2);
-  useGzip = fileStream.good() && bytes[0] == 0x1f && bytes[1] == 0x8b;
+  // check the magic number to see if this is a gzip stream or a
+  // block container
+  unsigned char bytes[4] = {0, 0, 0, 0};
+  fileStream.read((char*)bytes, 4);
+  useGzip = fileStream.gcount() >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b;
+  useBlocks = fileStream.good() && BlockStream::isBlockFile(bytes);
 
   // seek to the start of the input file and clear any flags
   fileStream.clear();
   fileStream.seekg(0, std::ifstream::beg);
 
+  // an uncompressed file is read straight from a mapping, in which
+  // case the file stream is no longer needed
+  if (useMmap && !useGzip && !useBlocks && fileStream.is_open() &&
+      mapFile())
+    fileStream.close();
+
   createStreams();
 }
 
+bool ProtoInputStream::mapFile() {
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  mappedData = data;
+  mappedSize = st.st_size;
+  return true;
+}
+
 void ProtoInputStream::createStreams() {
   // All streams should be NULL at this point
   assert(
       wrappedFileStream == NULL && gzipStream == NULL &&
-      zeroCopyStream == NULL);
+      blockStream == NULL && zeroCopyStream == NULL);
+
+  if (mappedData != NULL) {
+    // Array streams take an int size, so a large mapping is split
+    // into slices that are read back to back
+    const char* data = static_cast<const char*>(mappedData);
+    for (size_t offset = 0; offset < mappedSize; offset += mappedChunkSize) {
+      size_t size = std::min(mappedChunkSize, mappedSize - offset);
+      mappedStreams.push_back(
+          new io::ArrayInputStream(data + offset, static_cast<int>(size)));
+    }
+    if (mappedStreams.size() == 1) {
+      zeroCopyStream = mappedStreams[0];
+    } else {
+      concatStream = new io::ConcatenatingInputStream(
+          mappedStreams.data(), static_cast<int>(mappedStreams.size()));
+      zeroCopyStream = concatStream;
+    }
+    return;
+  }
+
+  // A block container is decompressed by its own stream, reading
+  // from the file stream directly
+  if (useBlocks) {
+    blockStream = new BlockInputStream(&fileStream);
+    zeroCopyStream = blockStream;
+    return;
+  }
 
   // Wrap the input file in a zero copy stream, that in turn is
   // wrapped in a gzip stream if the filename ends with .gz. The
@@ -136,27 +253,132 @@ void ProtoInputStream::destroyStreams() {
     delete gzipStream;
     gzipStream = NULL;
   }
+  if (blockStream != NULL) {
+    delete blockStream;
+    blockStream = NULL;
+  }
   delete wrappedFileStream;
   wrappedFileStream = NULL;
 
+  if (concatStream != NULL) {
+    delete concatStream;
+    concatStream = NULL;
+  }
+  for (auto stream : mappedStreams)
+    delete stream;
+  mappedStreams.clear();
+
   zeroCopyStream = NULL;
 }
 
 ProtoInputStream::~ProtoInputStream() {
   destroyStreams();
+  if (mappedData != NULL)
+    munmap(mappedData, mappedSize);
   fileStream.close();
 }
 
 void ProtoInputStream::reset() {
   destroyStreams();
+  streamStart = 0;
   // seek to the start of the input file and clear any flags
+  if (mappedData == NULL) {
+    fileStream.clear();
+    fileStream.seekg(0, std::ifstream::beg);
+  }
+  createStreams();
+}
+
+uint64_t ProtoInputStream::tell() const {
+  return streamStart + zeroCopyStream->ByteCount();
+}
+
+uint64_t ProtoInputStream::fileByteCount() const {
+  if (blockStream != NULL) {
+    return blockStream->compressedByteCount();
+  }
+  if (gzipStream != NULL) {
+    return wrappedFileStream->ByteCount();
+  }
+  return tell();
+}
+
+bool ProtoInputStream::seek(uint64_t offset) {
+  // A mapped file is skipped through in place, and a block container
+  // finds the block holding the offset through its block table
+  if (mappedData != NULL) {
+    reset();
+    return offset <= mappedSize && skip(offset);
+  }
+  if (useBlocks) {
+    // The block stream keeps its table and only moves to another block
+    return blockStream->seek(offset);
+  }
+  if (useGzip) {
+    reset();
+    return skip(offset);
+  }
+
+  // A plain file is read again from the offset onwards
+  destroyStreams();
   fileStream.clear();
-  fileStream.seekg(0, std::ifstream::beg);
+  fileStream.seekg(offset, std::ifstream::beg);
+  streamStart = offset;
+  createStreams();
+  return fileStream.good();
+}
+
+void ProtoInputStream::suspend() {
+  if (suspended)
+    return;
+  suspendedOffset = tell();
+  destroyStreams();
+  if (mappedData != NULL) {
+    munmap(mappedData, mappedSize);
+    mappedData = NULL;
+    mappedSize = 0;
+  }
+  fileStream.close();
+  suspended = true;
+}
+
+bool ProtoInputStream::resume() {
+  if (!suspended)
+    return true;
+  fileStream.clear();
+  fileStream.open(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!fileStream.good())
+    return false;
+
+  if (useMmap && !useGzip && !useBlocks && mapFile())
+    fileStream.close();
+  suspended = false;
+  streamStart = 0;
   createStreams();
+  return seek(suspendedOffset);
+}
+
+bool ProtoInputStream::isSuspended() const {
+  return suspended;
+}
+
+bool ProtoInputStream::skip(uint64_t count) {
+  while (count > 0) {
+    int step = static_cast<int>(
+        std::min<uint64_t>(count, std::numeric_limits<int>::max()));
+    if (!zeroCopyStream->Skip(step))
+      return false;
+    count -= step;
+  }
+  return true;
 }
 
 bool ProtoInputStream::is_open() {
-  return fileStream.is_open();
+  return mappedData != NULL || fileStream.is_open();
+}
+
+bool ProtoInputStream::isMapped() const {
+  return mappedData != NULL;
 }
 
 bool ProtoInputStream::read(Message& msg) {
@@ -182,3 +404,42 @@ bool ProtoInputStream::read(Message& msg) {
 
   return false;
 }
+
+bool ProtoInputStream::readRecord(std::string& record) {
+  // Same framing as read(), but the message bytes are copied out
+  // instead of being parsed
+  uint32_t size;
+
+  io::CodedInputStream codedStream(zeroCopyStream);
+  if (codedStream.ReadVarint32(&size)) {
+    if (codedStream.ReadString(&record, size)) {
+      return true;
+    } else {
+      panic("Unable to read message from coded stream %s\n", fileName);
+    }
+  }
+
+  return false;
+}
+
+bool ProtoInputStream::readRecordView(const char*& data, size_t& size) {
+  assert(mappedData != NULL);
+  // Everything handed out by earlier coded streams has been consumed,
+  // so the byte count is the offset of the next message
+  uint64_t offset = zeroCopyStream->ByteCount();
+  uint32_t msgSize;
+
+  io::CodedInputStream codedStream(zeroCopyStream);
+  if (codedStream.ReadVarint32(&msgSize)) {
+    uint64_t start = offset + codedStream.CurrentPosition();
+    if (start + msgSize <= mappedSize && codedStream.Skip(msgSize)) {
+      data = static_cast<const char*>(mappedData) + start;
+      size = msgSize;
+      return true;
+    } else {
+      panic("Unable to read message from coded stream %s\n", fileName);
+    }
+  }
+
+  return false;
+}
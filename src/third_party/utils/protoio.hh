@@ -49,6 +49,9 @@
 #include <google/protobuf/message.h>
 
 #include <fstream>
+#include <vector>
+
+#include "blockio.hh"
 
 /**
  * A ProtoStream provides the shared functionality of the input and
@@ -86,7 +89,9 @@ class ProtoOutputStream : public ProtoStream {
  public:
   /**
    * Create an output stream for a given file name. If the filename
-   * ends with .gz then the file will be compressed accordinly.
+   * ends with .gz then the file will be compressed accordinly, and if
+   * it ends with .zb the messages are written as independently
+   * compressed blocks (see blockio.hh).
    *
    * @param filename Path to the file to create or truncate
    */
@@ -106,6 +111,22 @@ class ProtoOutputStream : public ProtoStream {
    */
   void write(const google::protobuf::Message& msg);
 
+  /**
+   * Write the serialized bytes of a message, as read by
+   * ProtoInputStream::readRecord, without parsing them, prepending
+   * them with their size.
+   *
+   * @param record Bytes of the message to write to the stream
+   */
+  void writeRecord(const std::string& record);
+
+  /**
+   * Get the offset the next message will be written at. For
+   * compressed files this is the offset in the uncompressed stream,
+   * matching ProtoInputStream::tell() when the file is read back.
+   */
+  uint64_t tell() const;
+
  private:
   /// Underlying file output stream
   std::ofstream fileStream;
@@ -116,6 +137,9 @@ class ProtoOutputStream : public ProtoStream {
   /// Optional Gzip stream to wrap the Zero Copy stream
   google::protobuf::io::GzipOutputStream* gzipStream;
 
+  /// Optional block stream writing straight to the file stream
+  BlockOutputStream* blockStream;
+
   /// Top-level zero-copy stream, either with compression or not
   google::protobuf::io::ZeroCopyOutputStream* zeroCopyStream;
 };
@@ -130,12 +154,16 @@ class ProtoOutputStream : public ProtoStream {
 class ProtoInputStream : public ProtoStream {
  public:
   /**
-   * Create an input stream for a given file name. If the filename
-   * ends with .gz then the file will be decompressed accordingly.
+   * Create an input stream for a given file name. If the file starts
+   * with the gzip or block container magic it will be decompressed
+   * accordingly.
+   * Uncompressed files are memory-mapped when possible, so messages
+   * are parsed directly from the page cache.
    *
    * @param filename Path to the file to read from
+   * @param useMmap Map uncompressed files instead of reading them
    */
-  ProtoInputStream(const std::string& filename);
+  ProtoInputStream(const std::string& filename, bool useMmap = true);
 
   /**
    * Destruct the input stream, and also close the underlying file
@@ -153,11 +181,82 @@ class ProtoInputStream : public ProtoStream {
    */
   bool read(google::protobuf::Message& msg);
 
+  /**
+   * Read the serialized bytes of the next message without parsing
+   * them, so that parsing can be done elsewhere with ParseFromArray.
+   *
+   * @param record Bytes of the message read from the stream
+   * @param return True if a message was read, false if reading fails
+   */
+  bool readRecord(std::string& record);
+
+  /**
+   * Locate the serialized bytes of the next message in the mapped
+   * file without copying them. Only usable when isMapped() is true;
+   * the bytes stay valid for the lifetime of the stream.
+   *
+   * @param data Start of the message in the mapping
+   * @param size Size of the message in bytes
+   * @param return True if a message was found, false if reading fails
+   */
+  bool readRecordView(const char*& data, size_t& size);
+
+  /**
+   * Check whether the file is read through a memory mapping.
+   */
+  bool isMapped() const;
+
   /**
    * Reset the input stream and seek to the beginning of the file.
    */
   void reset();
 
+  /**
+   * Get the offset of the next message, to go back to it with
+   * seek(). For compressed files this is the offset in the
+   * uncompressed stream.
+   */
+  uint64_t tell() const;
+
+  /**
+   * Get the number of bytes read from the file by the current
+   * streams, which for compressed files counts compressed bytes,
+   * including those read ahead. Mapped and plain files count the
+   * bytes consumed, as tell() does. The count may start over when
+   * the streams are recreated by seek() or resume().
+   */
+  uint64_t fileByteCount() const;
+
+  /**
+   * Continue reading from an offset returned by tell(). Block
+   * containers only decompress the block holding the offset, whereas
+   * gzip files are decompressed from the start up to it.
+   *
+   * @param offset Offset of a message in the stream
+   * @param return True if the offset is within the file
+   */
+  bool seek(uint64_t offset);
+
+  /**
+   * Close the file, and unmap it if it is mapped, remembering the
+   * position so that resume() can reopen it and continue from there.
+   * This keeps many streams from holding on to file descriptors and
+   * mappings while they are not being read.
+   */
+  void suspend();
+
+  /**
+   * Reopen a suspended file and seek back to where it was suspended.
+   *
+   * @param return True if the file could be reopened
+   */
+  bool resume();
+
+  /**
+   * Check whether the stream is suspended.
+   */
+  bool isSuspended() const;
+
  private:
   /**
    * Create the internal streams that are wrapping the input file.
@@ -169,6 +268,24 @@ class ProtoInputStream : public ProtoStream {
    */
   void destroyStreams();
 
+  /**
+   * Map the whole input file into memory.
+   *
+   * @param return True if the file was mapped
+   */
+  bool mapFile();
+
+  /**
+   * Skip bytes of the top-level stream, which only skips an int at a
+   * time.
+   *
+   * @param return False if the end of the stream was reached first
+   */
+  bool skip(uint64_t count);
+
+  /// Largest slice of the mapping handed to a single array stream
+  static const size_t mappedChunkSize = 1 << 30;
+
   /// Underlying file input stream
   std::ifstream fileStream;
 
@@ -178,14 +295,40 @@ class ProtoInputStream : public ProtoStream {
   /// Boolean flag to remember whether we use gzip or not
   bool useGzip;
 
+  /// Boolean flag to remember whether the file may be mapped
+  const bool useMmap;
+
   /// Zero Copy stream wrapping the STL input stream
   google::protobuf::io::IstreamInputStream* wrappedFileStream;
 
   /// Optional Gzip stream to wrap the Zero Copy stream
   google::protobuf::io::GzipInputStream* gzipStream;
 
+  /// Boolean flag to remember whether the file is block-compressed
+  bool useBlocks;
+
+  /// Optional block stream reading straight from the file stream
+  BlockInputStream* blockStream;
+
+  /// Start and size of the memory-mapped file, if it is mapped
+  void* mappedData;
+  size_t mappedSize;
+
+  /// Array streams over consecutive slices of the mapping
+  std::vector<google::protobuf::io::ZeroCopyInputStream*> mappedStreams;
+
+  /// Stream concatenating the slices when there is more than one
+  google::protobuf::io::ConcatenatingInputStream* concatStream;
+
   /// Top-level zero-copy stream, either with compression or not
   google::protobuf::io::ZeroCopyInputStream* zeroCopyStream;
+
+  /// Offset in the file at which the current streams started reading
+  uint64_t streamStart;
+
+  /// Whether the file is closed by suspend(), and where to resume
+  bool suspended;
+  uint64_t suspendedOffset;
 };
 
 #endif //__PROTO_PROTOIO_HH
@@ -0,0 +1,506 @@
+#include <benchmark/benchmark.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include "et_feeder.h"
+#include "wrapper_node.h"
+
+// Feeder benchmarks over synthetic traces. Besides the usual timings, each
+// drain benchmark reports:
+//   items_per_second  nodes issued and completed per second
+//   first_window_ms   time to open the trace and read the first window
+//   max_refill_ms     longest removeNode call, i.e. the worst window refill
+//   peak_rss_mb       peak resident set size of the whole process so far,
+//                     so run one benchmark per process (--benchmark_filter)
+//                     when comparing memory
+// and the memory budget runs (BM_FeederDrainBudget) add:
+//   peak_graph_mb     largest estimated size of the dependency graph
+//   budget_stalls     times the budget held reading back
+//
+// Trace sizes run in powers of ten from 10^4 up to --max_nodes (default
+// 10^5, up to 10^8 for large runs) for the protobuf feeder, and up to
+// --max_json_nodes (default 10^5) for JSON traces through WrapperNode, whose
+// files are several times larger than protobuf traces of the same size.
+
+namespace {
+enum class Shape { Chain, FanOutIn, Collective, ForwardReference };
+
+const Shape kShapes[] = {
+    Shape::Chain,
+    Shape::FanOutIn,
+    Shape::Collective,
+    Shape::ForwardReference};
+
+const char* shapeName(Shape shape) {
+  switch (shape) {
+    case Shape::Chain:
+      return "chain";
+    case Shape::FanOutIn:
+      return "fan_out_in";
+    case Shape::Collective:
+      return "collective";
+    case Shape::ForwardReference:
+      return "forward_reference";
+  }
+  return "unknown";
+}
+
+// Width of each fan-out/fan-in stage
+const uint64_t kFanWidth = 64;
+
+// Parents of node i in a synthetic trace of num_nodes nodes:
+//   chain              every node depends on the one before it
+//   fan_out_in         a root fans out to kFanWidth nodes that join into a
+//                      single node, which is the next stage's parent
+//   collective         alternating compute and collective nodes, each
+//                      collective also depending on the previous one
+//   forward_reference  nodes in the first half depend on the node half a
+//                      trace later, so they wait on parents not read yet
+void syntheticDeps(
+    Shape shape,
+    uint64_t i,
+    uint64_t num_nodes,
+    std::vector<uint64_t>& deps) {
+  deps.clear();
+  switch (shape) {
+    case Shape::Chain:
+      if (i > 0) {
+        deps.push_back(i - 1);
+      }
+      break;
+    case Shape::FanOutIn: {
+      const uint64_t pos = i % (kFanWidth + 2);
+      const uint64_t root = i - pos;
+      if (pos == 0) {
+        if (root > 0) {
+          deps.push_back(root - 1);
+        }
+      } else if (pos <= kFanWidth) {
+        deps.push_back(root);
+      } else {
+        for (uint64_t j = root + 1; j <= root + kFanWidth; ++j) {
+          deps.push_back(j);
+        }
+      }
+      break;
+    }
+    case Shape::Collective:
+      if (i > 0) {
+        deps.push_back(i - 1);
+      }
+      if ((i % 2 == 1) && (i > 2)) {
+        deps.push_back(i - 2);
+      }
+      break;
+    case Shape::ForwardReference:
+      if (i < num_nodes / 2) {
+        deps.push_back(i + num_nodes / 2);
+      }
+      break;
+  }
+}
+
+bool isCollective(Shape shape, uint64_t i) {
+  return (shape == Shape::Collective) && (i % 2 == 1);
+}
+
+std::string syntheticFilename(
+    Shape shape,
+    uint64_t num_nodes,
+    const char* extension) {
+  return std::string("/tmp/chakra_bench_") + shapeName(shape) + "." +
+      std::to_string(num_nodes) + "." + extension;
+}
+
+std::string writeSyntheticTrace(Shape shape, uint64_t num_nodes) {
+  std::string filename = syntheticFilename(shape, num_nodes, "et");
+  ProtoOutputStream et(filename);
+  ChakraProtoMsg::GlobalMetadata metadata;
+  et.write(metadata);
+  std::vector<uint64_t> deps;
+  ChakraProtoMsg::Node node;
+  for (uint64_t i = 0; i < num_nodes; ++i) {
+    node.Clear();
+    node.set_id(i);
+    node.set_name("node_" + std::to_string(i));
+    node.set_duration_micros(10);
+    syntheticDeps(shape, i, num_nodes, deps);
+    for (uint64_t dep : deps) {
+      node.add_data_deps(dep);
+    }
+    if (isCollective(shape, i)) {
+      node.set_type(ChakraProtoMsg::COMM_COLL_NODE);
+      ChakraProtoMsg::AttributeProto* comm_type = node.add_attr();
+      comm_type->set_name("comm_type");
+      comm_type->set_int64_val(ChakraProtoMsg::ALL_REDUCE);
+      ChakraProtoMsg::AttributeProto* comm_size = node.add_attr();
+      comm_size->set_name("comm_size");
+      comm_size->set_int64_val(1 << 20);
+    } else {
+      node.set_type(ChakraProtoMsg::COMP_NODE);
+      ChakraProtoMsg::AttributeProto* num_ops = node.add_attr();
+      num_ops->set_name("num_ops");
+      num_ops->set_int64_val(1 << 16);
+    }
+    et.write(node);
+  }
+  return filename;
+}
+
+std::string writeSyntheticJson(Shape shape, uint64_t num_nodes) {
+  std::string filename = syntheticFilename(shape, num_nodes, "json");
+  std::ofstream out(filename);
+  std::vector<uint64_t> deps;
+  out << "{\n  \"workload_graph\": [\n";
+  for (uint64_t i = 0; i < num_nodes; ++i) {
+    syntheticDeps(shape, i, num_nodes, deps);
+    out << "    {\"Id\": " << i << ", \"Name\": \"node_" << i
+        << "\", \"NodeType\": "
+        << (isCollective(shape, i) ? ChakraProtoMsg::COMM_COLL_NODE
+                                   : ChakraProtoMsg::COMP_NODE)
+        << ", \"data_deps\": [";
+    for (size_t j = 0; j < deps.size(); ++j) {
+      out << (j ? ", " : "") << deps[j];
+    }
+    out << "], \"runtime\": 10, \"is_cpu_op\": false";
+    if (isCollective(shape, i)) {
+      out << ", \"tensor_size\": 1048576, \"comm_type\": 0"
+          << ", \"comm_size\": 1048576";
+    }
+    out << "}" << (i + 1 < num_nodes ? "," : "") << "\n";
+  }
+  out << "  ]\n}\n";
+  return filename;
+}
+
+double peakRssMegabytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  // ru_maxrss is in kilobytes on Linux
+  return usage.ru_maxrss / 1024.0;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Writes a forward_reference trace of bare nodes, with only their IDs, types
+// and dependencies, so that window construction dominates reading them
+std::string writeForwardReferenceTrace(uint64_t num_nodes) {
+  std::string filename =
+      syntheticFilename(Shape::ForwardReference, num_nodes, "et");
+  ProtoOutputStream et(filename);
+  ChakraProtoMsg::GlobalMetadata metadata;
+  et.write(metadata);
+  std::vector<uint64_t> deps;
+  for (uint64_t i = 0; i < num_nodes; ++i) {
+    ChakraProtoMsg::Node node;
+    node.set_id(i);
+    node.set_type(ChakraProtoMsg::COMP_NODE);
+    syntheticDeps(Shape::ForwardReference, i, num_nodes, deps);
+    for (uint64_t dep : deps) {
+      node.add_data_deps(dep);
+    }
+    et.write(node);
+  }
+  return filename;
+}
+} // namespace
+
+// Window construction over a trace made only of forward references
+static void BM_ForwardReferenceWindow(benchmark::State& state) {
+  uint64_t num_nodes = static_cast<uint64_t>(state.range(0));
+  std::string filename = writeForwardReferenceTrace(num_nodes);
+  for (auto _ : state) {
+    Chakra::ETFeeder feeder(filename);
+    benchmark::DoNotOptimize(feeder.getNextIssuableNode());
+  }
+  state.SetComplexityN(state.range(0));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::remove(filename.c_str());
+}
+BENCHMARK(BM_ForwardReferenceWindow)
+    ->RangeMultiplier(4)
+    ->Range(1 << 10, 1 << 18)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+
+// Issues and completes every node, with and without arena allocation
+static void BM_DrainTrace(benchmark::State& state) {
+  const uint64_t num_nodes = 1 << 16;
+  std::string filename = writeForwardReferenceTrace(num_nodes);
+  Chakra::ETFeederOptions options;
+  options.window_size = 4096;
+  options.use_arena = state.range(0) != 0;
+  for (auto _ : state) {
+    Chakra::ETFeeder feeder(filename, options);
+    std::shared_ptr<Chakra::ETFeederNode> node;
+    while ((node = feeder.getNextIssuableNode()) != nullptr) {
+      feeder.freeChildrenNodes(node->id());
+      feeder.removeNode(node->id());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_nodes);
+  std::remove(filename.c_str());
+}
+BENCHMARK(BM_DrainTrace)
+    ->ArgName("use_arena")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+// Cost of telemetry on the same drain
+static void BM_DrainTraceStats(benchmark::State& state) {
+  const uint64_t num_nodes = 1 << 16;
+  std::string filename = writeForwardReferenceTrace(num_nodes);
+  Chakra::ETFeederOptions options;
+  options.window_size = 4096;
+  options.collect_stats = state.range(0) != 0;
+  for (auto _ : state) {
+    Chakra::ETFeeder feeder(filename, options);
+    std::shared_ptr<Chakra::ETFeederNode> node;
+    while ((node = feeder.getNextIssuableNode()) != nullptr) {
+      feeder.freeChildrenNodes(node->id());
+      feeder.removeNode(node->id());
+    }
+    benchmark::DoNotOptimize(feeder.stats());
+  }
+  state.SetItemsProcessed(state.iterations() * num_nodes);
+  std::remove(filename.c_str());
+}
+BENCHMARK(BM_DrainTraceStats)
+    ->ArgName("collect_stats")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+// Issues and retires nodes in batches of the given size
+static void BM_DrainTraceBatched(benchmark::State& state) {
+  const uint64_t num_nodes = 1 << 16;
+  std::string filename = writeForwardReferenceTrace(num_nodes);
+  Chakra::ETFeederOptions options;
+  options.window_size = 4096;
+  const size_t batch_size = static_cast<size_t>(state.range(0));
+  std::vector<std::shared_ptr<Chakra::ETFeederNode>> nodes;
+  std::vector<uint64_t> node_ids;
+  for (auto _ : state) {
+    Chakra::ETFeeder feeder(filename, options);
+    while (feeder.getNextIssuableNodes(nodes, batch_size) > 0) {
+      for (const auto& node : nodes) {
+        node_ids.push_back(node->id());
+      }
+      feeder.retireNodes(node_ids);
+      nodes.clear();
+      node_ids.clear();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_nodes);
+  std::remove(filename.c_str());
+}
+BENCHMARK(BM_DrainTraceBatched)
+    ->ArgName("batch_size")
+    ->RangeMultiplier(32)
+    ->Range(1, 1024)
+    ->Unit(benchmark::kMillisecond);
+
+// Pushes a batch of issuable nodes in shuffled order and pops them all, for
+// each IssuePolicy in declaration order
+static void BM_ReadyQueue(benchmark::State& state) {
+  const uint64_t num_nodes = 1 << 16;
+  std::vector<std::shared_ptr<Chakra::ETFeederNode>> nodes;
+  for (uint64_t i = 0; i < num_nodes; ++i) {
+    auto msg = std::make_shared<ChakraProtoMsg::Node>();
+    msg->set_id((i * 40503) % num_nodes);
+    msg->set_type(
+        (i % 2 == 1) ? ChakraProtoMsg::COMM_COLL_NODE
+                     : ChakraProtoMsg::COMP_NODE);
+    ChakraProtoMsg::AttributeProto* level = msg->add_attr();
+    level->set_name("bottom_level");
+    level->set_int64_val(i % 1000);
+    nodes.push_back(std::make_shared<Chakra::ETFeederNode>(msg));
+  }
+  Chakra::ReadyQueue queue(static_cast<Chakra::IssuePolicy>(state.range(0)));
+  for (auto _ : state) {
+    for (const auto& node : nodes) {
+      queue.push(node);
+    }
+    while (!queue.empty()) {
+      benchmark::DoNotOptimize(queue.pop());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_nodes);
+}
+BENCHMARK(BM_ReadyQueue)
+    ->ArgName("policy")
+    ->DenseRange(0, 4)
+    ->Unit(benchmark::kMillisecond);
+
+// Issues and completes every node of a synthetic trace through ETFeeder
+static void BM_FeederDrain(
+    benchmark::State& state,
+    Shape shape,
+    uint64_t num_nodes) {
+  std::string filename = writeSyntheticTrace(shape, num_nodes);
+  Chakra::ETFeederOptions options;
+  options.window_size = 4096;
+  uint64_t num_issued = 0;
+  double first_window_ms = 0;
+  double max_refill_ms = 0;
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    Chakra::ETFeeder feeder(filename, options);
+    first_window_ms += millisecondsSince(start);
+    std::shared_ptr<Chakra::ETFeederNode> node;
+    while ((node = feeder.getNextIssuableNode()) != nullptr) {
+      ++num_issued;
+      feeder.freeChildrenNodes(node->id());
+      start = std::chrono::steady_clock::now();
+      feeder.removeNode(node->id());
+      max_refill_ms = std::max(max_refill_ms, millisecondsSince(start));
+    }
+  }
+  state.SetItemsProcessed(num_issued);
+  state.counters["first_window_ms"] = first_window_ms / state.iterations();
+  state.counters["max_refill_ms"] = max_refill_ms;
+  state.counters["peak_rss_mb"] = peakRssMegabytes();
+  std::remove(filename.c_str());
+}
+
+// Same with the default window size, bounded by a memory budget instead
+static void BM_FeederDrainBudget(
+    benchmark::State& state,
+    Shape shape,
+    uint64_t num_nodes) {
+  std::string filename = writeSyntheticTrace(shape, num_nodes);
+  Chakra::ETFeederOptions options;
+  options.memory_budget_bytes = 1 << 20;
+  uint64_t num_issued = 0;
+  uint64_t peak_graph_bytes = 0;
+  uint64_t num_budget_stalls = 0;
+  for (auto _ : state) {
+    Chakra::ETFeeder feeder(filename, options);
+    std::shared_ptr<Chakra::ETFeederNode> node;
+    while ((node = feeder.getNextIssuableNode()) != nullptr) {
+      ++num_issued;
+      feeder.freeChildrenNodes(node->id());
+      feeder.removeNode(node->id());
+    }
+    peak_graph_bytes = std::max(peak_graph_bytes, feeder.peakGraphBytes());
+    num_budget_stalls += feeder.numBudgetStalls();
+  }
+  state.SetItemsProcessed(num_issued);
+  state.counters["peak_graph_mb"] = peak_graph_bytes / (1024.0 * 1024.0);
+  state.counters["budget_stalls"] =
+      static_cast<double>(num_budget_stalls) / state.iterations();
+  state.counters["peak_rss_mb"] = peakRssMegabytes();
+  std::remove(filename.c_str());
+}
+
+// Same through WrapperNode, from either a protobuf or a JSON trace
+static void BM_WrapperDrain(
+    benchmark::State& state,
+    Shape shape,
+    uint64_t num_nodes,
+    bool use_json) {
+  std::string filename = use_json ? writeSyntheticJson(shape, num_nodes)
+                                  : writeSyntheticTrace(shape, num_nodes);
+  uint64_t num_issued = 0;
+  double first_window_ms = 0;
+  double max_refill_ms = 0;
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    WrapperNode wrapper(filename);
+    first_window_ms += millisecondsSince(start);
+    while (true) {
+      wrapper.getNextIssuableNode();
+      if (!wrapper.isValidNode()) {
+        break;
+      }
+      ++num_issued;
+      uint64_t node_id = wrapper.getNodeID();
+      benchmark::DoNotOptimize(wrapper.getRuntime());
+      wrapper.freeChildrenNodes(node_id);
+      start = std::chrono::steady_clock::now();
+      wrapper.removeNode(node_id);
+      max_refill_ms = std::max(max_refill_ms, millisecondsSince(start));
+    }
+    wrapper.releaseMemory();
+  }
+  state.SetItemsProcessed(num_issued);
+  state.counters["first_window_ms"] = first_window_ms / state.iterations();
+  state.counters["max_refill_ms"] = max_refill_ms;
+  state.counters["peak_rss_mb"] = peakRssMegabytes();
+  std::remove(filename.c_str());
+}
+
+namespace {
+// Removes --name=value from the arguments, returning its value if present
+uint64_t takeFlag(int& argc, char** argv, const char* name, uint64_t value) {
+  const std::string prefix = std::string("--") + name + "=";
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], prefix.c_str(), prefix.size()) == 0) {
+      value = std::strtoull(argv[i] + prefix.size(), nullptr, 10);
+      for (int j = i; j + 1 < argc; ++j) {
+        argv[j] = argv[j + 1];
+      }
+      --argc;
+      break;
+    }
+  }
+  return value;
+}
+
+void registerSyntheticBenchmarks(uint64_t max_nodes, uint64_t max_json_nodes) {
+  for (Shape shape : kShapes) {
+    for (uint64_t n = 10000; n <= max_nodes; n *= 10) {
+      std::string suffix =
+          std::string("/") + shapeName(shape) + "/" + std::to_string(n);
+      benchmark::RegisterBenchmark(
+          ("BM_FeederDrain" + suffix).c_str(), BM_FeederDrain, shape, n)
+          ->Unit(benchmark::kMillisecond);
+      benchmark::RegisterBenchmark(
+          ("BM_FeederDrainBudget" + suffix).c_str(),
+          BM_FeederDrainBudget,
+          shape,
+          n)
+          ->Unit(benchmark::kMillisecond);
+      benchmark::RegisterBenchmark(
+          ("BM_WrapperDrain/et" + suffix).c_str(),
+          BM_WrapperDrain,
+          shape,
+          n,
+          false)
+          ->Unit(benchmark::kMillisecond);
+    }
+    for (uint64_t n = 10000; n <= max_json_nodes; n *= 10) {
+      std::string suffix =
+          std::string("/") + shapeName(shape) + "/" + std::to_string(n);
+      benchmark::RegisterBenchmark(
+          ("BM_WrapperDrain/json" + suffix).c_str(),
+          BM_WrapperDrain,
+          shape,
+          n,
+          true)
+          ->Unit(benchmark::kMillisecond);
+    }
+  }
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  uint64_t max_nodes = takeFlag(argc, argv, "max_nodes", 100000);
+  uint64_t max_json_nodes = takeFlag(argc, argv, "max_json_nodes", 100000);
+  registerSyntheticBenchmarks(max_nodes, max_json_nodes);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -1,13 +1,77 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include "et_critical_path.h"
 #include "et_feeder.h"
+#include "et_feeder_group.h"
+
+namespace {
+// Writes a trace in which node i depends on node i + 1, so that every
+// dependency refers to a node that appears later in the file
+std::string writeForwardReferenceTrace(uint64_t num_nodes) {
+  std::string filename = ::testing::TempDir() + "forward_reference.et";
+  ProtoOutputStream et(filename);
+  ChakraProtoMsg::GlobalMetadata metadata;
+  et.write(metadata);
+  for (uint64_t i = 0; i < num_nodes; ++i) {
+    ChakraProtoMsg::Node node;
+    node.set_id(i);
+    node.set_type(ChakraProtoMsg::COMP_NODE);
+    if (i + 1 < num_nodes) {
+      node.add_data_deps(i + 1);
+    }
+    et.write(node);
+  }
+  return filename;
+}
+
+// Copies a trace into a block container with the given number of messages
+// per block
+std::string writeBlockTrace(
+    const std::string& src,
+    uint32_t messages_per_block) {
+  std::string filename = ::testing::TempDir() + "block_trace.zb";
+  ProtoInputStream in(src);
+  std::ofstream file(filename, std::ios::out | std::ios::binary);
+  BlockOutputStream out(&file, messages_per_block);
+  std::string record;
+  while (in.readRecord(record)) {
+    {
+      google::protobuf::io::CodedOutputStream coded(&out);
+      coded.WriteVarint32(record.size());
+      coded.WriteString(record);
+    }
+    out.endMessage();
+  }
+  out.close();
+  return filename;
+}
+
+// Issues and completes every node one at a time, returning the node IDs in
+// issue order
+std::vector<uint64_t> drainTrace(Chakra::ETFeeder& feeder) {
+  std::vector<uint64_t> issued;
+  std::shared_ptr<Chakra::ETFeederNode> node;
+  while ((node = feeder.getNextIssuableNode()) != nullptr) {
+    issued.push_back(node->id());
+    feeder.freeChildrenNodes(node->id());
+    feeder.removeNode(node->id());
+  }
+  return issued;
+}
+} // namespace
 
 class ETFeederTest : public ::testing::Test {
  protected:
   ETFeederTest() {}
   virtual ~ETFeederTest() {}
 
-  void SetUp(const std::string& filename) {
-    trace = new Chakra::ETFeeder(filename);
+  void SetUp(
+      const std::string& filename,
+      const Chakra::ETFeederOptions& options = Chakra::ETFeederOptions()) {
+    trace = new Chakra::ETFeeder(filename, options);
   }
 
   virtual void TearDown() {
@@ -63,14 +127,14 @@ TEST_F(ETFeederTest, RemoveTest) {
   std::shared_ptr<Chakra::ETFeederNode> node = trace->lookupNode(216);
   ASSERT_EQ(node->id(), 216);
   trace->removeNode(216);
-  freopen("/dev/null", "w", stderr);
+  testing::internal::CaptureStderr();
   try {
     node = trace->lookupNode(216);
     ASSERT_TRUE(false) << "node should be removed \n";
   } catch (const std::exception& e) {
     // this is the desired behaviour
   }
-  freopen("/dev/tty", "w", stderr);
+  testing::internal::GetCapturedStderr();
 }
 
 TEST_F(ETFeederTest, RemoveAndGetNextTest) {
@@ -133,6 +197,670 @@ TEST_F(ETFeederTest, NodeGetChildrenTest) {
   ASSERT_EQ(children[2]->id(), 435);
 }
 
+TEST_F(ETFeederTest, ChildSpanTest) {
+  SetUp("tests/data/chakra.0.et");
+  std::shared_ptr<Chakra::ETFeederNode> node = trace->lookupNode(216);
+  Chakra::ChildSpan children = node->children();
+  std::vector<std::shared_ptr<Chakra::ETFeederNode>> copy =
+      node->getChildren();
+  ASSERT_EQ(children.size(), copy.size());
+  for (size_t i = 0; i < children.size(); ++i) {
+    ASSERT_EQ(children[i], copy[i].get());
+  }
+  // Children added one at a time go after the ones linked with the window
+  std::shared_ptr<Chakra::ETFeederNode> extra = trace->lookupNode(432);
+  ASSERT_TRUE(node->addChild(extra));
+  ASSERT_FALSE(node->addChild(extra));
+  ASSERT_EQ(node->children().size(), copy.size() + 1);
+  ASSERT_EQ(node->children()[copy.size()], extra.get());
+  trace->removeNode(216);
+  ASSERT_TRUE(node->children().empty());
+}
+
+TEST_F(ETFeederTest, ChildOwnershipTest) {
+  SetUp("tests/data/chakra.0.et");
+  std::shared_ptr<Chakra::ETFeederNode> node = trace->getNextIssuableNode();
+  ASSERT_EQ(node->id(), 216);
+  trace->freeChildrenNodes(216);
+  // The graph owns the children, so a child removed before its parent is
+  // freed even though its parent still lists it
+  std::weak_ptr<Chakra::ETFeederNode> child = node->getChildren()[0];
+  ASSERT_EQ(trace->getNextIssuableNode()->id(), 217);
+  trace->freeChildrenNodes(217);
+  trace->removeNode(217);
+  ASSERT_TRUE(child.expired());
+  trace->removeNode(216);
+}
+
+TEST_F(ETFeederTest, DeepChainTest) {
+  // Every node is linked in the same window as its parent, so the children
+  // blocks must not keep the chain alive once the feeder is gone
+  SetUp(writeForwardReferenceTrace(1 << 18));
+  std::weak_ptr<Chakra::ETFeederNode> first = trace->getNextIssuableNode();
+  std::weak_ptr<Chakra::ETFeederNode> last = trace->lookupNode(0);
+  delete trace;
+  trace = nullptr;
+  ASSERT_TRUE(first.expired());
+  ASSERT_TRUE(last.expired());
+}
+
+TEST_F(ETFeederTest, NodeAttrAccessTest) {
+  SetUp("tests/data/chakra.0.et");
+  std::shared_ptr<Chakra::ETFeederNode> node = trace->lookupNode(216);
+  std::shared_ptr<ChakraProtoMsg::Node> msg = node->getChakraNode();
+  // Strings are read in place from the message
+  ASSERT_EQ(&node->name(), &msg->name());
+  ASSERT_EQ(&node->get_inputs_shapes(), &msg->inputs().shapes());
+  ASSERT_EQ(node->get_outputs_types(), msg->outputs().types());
+  ASSERT_EQ(node->runtime(), msg->duration_micros());
+  ASSERT_TRUE(node->is_cpu_op());
+  ASSERT_EQ(node->get_other_attr("rf_id").int64_val(), 2);
+  // Attributes missing from a compute node read as zero
+  ASSERT_EQ(node->comm_size(), 0);
+  ASSERT_EQ(node->pg_name(), "");
+}
+
+TEST_F(ETFeederTest, TypedAttrTest) {
+  ASSERT_EQ(Chakra::lookupAttrId("rf_id"), Chakra::AttrId::rf_id);
+  ASSERT_EQ(Chakra::lookupAttrId("rf_i"), Chakra::AttrId::Unknown);
+
+  SetUp("tests/data/chakra.0.et");
+  std::shared_ptr<Chakra::ETFeederNode> node = trace->lookupNode(216);
+  ASSERT_TRUE(node->has_attr(Chakra::AttrId::rf_id));
+  ASSERT_EQ(node->get_attr<int64_t>(Chakra::AttrId::rf_id), 2);
+  ASSERT_TRUE(node->get_attr<bool>(Chakra::AttrId::is_cpu_op));
+  ASSERT_FALSE(node->has_attr(Chakra::AttrId::comm_size));
+  ASSERT_EQ(node->get_attr<int64_t>(Chakra::AttrId::comm_size), 0);
+  ASSERT_EQ(node->get_attr<std::string>(Chakra::AttrId::pg_name), "");
+
+  // Names outside the table are still found through the name lookup
+  node = trace->lookupNode(435);
+  ASSERT_EQ(
+      node->comm_size(),
+      node->get_other_attr("comm_size").int64_val());
+  ASSERT_TRUE(node->has_other_attr("involved_dim"));
+  ASSERT_FALSE(node->has_other_attr("not_an_attr"));
+}
+
+TEST_F(ETFeederTest, ForwardReferenceTest) {
+  SetUp(writeForwardReferenceTrace(1000));
+  std::shared_ptr<Chakra::ETFeederNode> node = trace->getNextIssuableNode();
+  ASSERT_EQ(node->id(), 999);
+  ASSERT_EQ(trace->getNextIssuableNode(), nullptr);
+  for (uint64_t id = 999; id > 0; --id) {
+    std::vector<std::shared_ptr<Chakra::ETFeederNode>> children =
+        node->getChildren();
+    ASSERT_EQ(children.size(), 1);
+    ASSERT_EQ(children[0]->id(), id - 1);
+    trace->freeChildrenNodes(id);
+    trace->removeNode(id);
+    node = trace->getNextIssuableNode();
+    ASSERT_EQ(node->id(), id - 1);
+  }
+  trace->removeNode(0);
+  ASSERT_FALSE(trace->hasNodesToIssue());
+}
+
+TEST_F(ETFeederTest, FreeChildrenKeepsDepsTest) {
+  SetUp("tests/data/chakra.0.et");
+  std::shared_ptr<Chakra::ETFeederNode> child = trace->lookupNode(217);
+  ASSERT_EQ(child->getNumUnfinishedParents(), 1);
+  trace->freeChildrenNodes(216);
+  trace->freeChildrenNodes(216);
+  ASSERT_EQ(child->getNumUnfinishedParents(), 0);
+  ASSERT_EQ(child->getChakraNode()->data_deps_size(), 1);
+  ASSERT_EQ(child->getChakraNode()->data_deps(0), 216);
+}
+
+TEST_F(ETFeederTest, SmallWindowTest) {
+  Chakra::ETFeederOptions options;
+  options.window_size = 64;
+  SetUp("tests/data/chakra.0.et", options);
+  std::vector<uint64_t> issued = drainTrace(*trace);
+  ASSERT_EQ(issued.size(), 3664);
+  ASSERT_FALSE(trace->hasNodesToIssue());
+}
+
+TEST_F(ETFeederTest, ArenaTest) {
+  Chakra::ETFeederOptions options;
+  options.window_size = 64;
+  options.use_arena = true;
+  SetUp("tests/data/chakra.0.et", options);
+  std::shared_ptr<Chakra::ETFeederNode> node = trace->lookupNode(216);
+  ASSERT_EQ(node->get_other_attr("rf_id").int64_val(), 2);
+
+  options.use_arena = false;
+  Chakra::ETFeeder reference("tests/data/chakra.0.et", options);
+  std::vector<uint64_t> issued = drainTrace(*trace);
+  ASSERT_EQ(issued, drainTrace(reference));
+  ASSERT_FALSE(trace->hasNodesToIssue());
+}
+
+TEST_F(ETFeederTest, PrefetchTest) {
+  Chakra::ETFeederOptions options;
+  options.window_size = 64;
+  options.use_arena = true;
+  options.prefetch = true;
+  options.prefetch_low_watermark = 8;
+  options.prefetch_high_watermark = 32;
+  SetUp("tests/data/chakra.0.et", options);
+
+  options.prefetch = false;
+  Chakra::ETFeeder reference("tests/data/chakra.0.et", options);
+  std::vector<uint64_t> issued = drainTrace(*trace);
+  ASSERT_EQ(issued.size(), 3664);
+  ASSERT_EQ(issued, drainTrace(reference));
+  ASSERT_FALSE(trace->hasNodesToIssue());
+}
+
+TEST_F(ETFeederTest, ParallelDecodeTest) {
+  Chakra::ETFeederOptions options;
+  options.window_size = 64;
+  options.num_decode_threads = 4;
+  options.decode_batch_size = 100;
+  SetUp("tests/data/chakra.0.et", options);
+  std::shared_ptr<Chakra::ETFeederNode> node = trace->lookupNode(216);
+  ASSERT_EQ(node->get_other_attr("rf_id").int64_val(), 2);
+
+  options.num_decode_threads = 0;
+  Chakra::ETFeeder reference("tests/data/chakra.0.et", options);
+  std::vector<uint64_t> issued = drainTrace(*trace);
+  ASSERT_EQ(issued.size(), 3664);
+  ASSERT_EQ(issued, drainTrace(reference));
+}
+
+TEST_F(ETFeederTest, NoMmapTest) {
+  Chakra::ETFeederOptions options;
+  options.window_size = 64;
+  options.use_mmap = false;
+  options.num_decode_threads = 2;
+  SetUp("tests/data/chakra.0.et", options);
+
+  options.use_mmap = true;
+  Chakra::ETFeeder reference("tests/data/chakra.0.et", options);
+  std::vector<uint64_t> issued = drainTrace(*trace);
+  ASSERT_EQ(issued.size(), 3664);
+  ASSERT_EQ(issued, drainTrace(reference));
+}
+
+TEST_F(ETFeederTest, BlockCompressedTest) {
+  std::string filename = writeBlockTrace("tests/data/chakra.0.et", 100);
+  Chakra::ETFeederOptions options;
+  options.window_size = 64;
+  SetUp(filename, options);
+
+  Chakra::ETFeeder reference("tests/data/chakra.0.et", options);
+  std::vector<uint64_t> issued = drainTrace(*trace);
+  ASSERT_EQ(issued.size(), 3664);
+  ASSERT_EQ(issued, drainTrace(reference));
+
+  // Any block can be read without going through the ones before it
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  BlockInputStream blocks(&file);
+  ASSERT_EQ(blocks.numBlocks(), 37);
+  ASSERT_TRUE(blocks.seekBlock(20));
+  ASSERT_EQ(blocks.blockFirstMessage(20), 2000);
+
+  // Message 0 is the metadata, so message 2000 is node 1999
+  ProtoInputStream plain("tests/data/chakra.0.et");
+  ChakraProtoMsg::GlobalMetadata metadata;
+  ChakraProtoMsg::Node expected;
+  plain.read(metadata);
+  for (int i = 0; i < 2000; ++i) {
+    plain.read(expected);
+  }
+  ChakraProtoMsg::Node node;
+  uint32_t size;
+  google::protobuf::io::CodedInputStream coded(&blocks);
+  ASSERT_TRUE(coded.ReadVarint32(&size));
+  coded.PushLimit(size);
+  ASSERT_TRUE(node.ParseFromCodedStream(&coded));
+  ASSERT_EQ(node.id(), expected.id());
+}
+
+TEST_F(ETFeederTest, BlockCompressedOutputTest) {
+  std::string filename = ::testing::TempDir() + "block_output.zb";
+  {
+    ProtoOutputStream et(filename);
+    ChakraProtoMsg::GlobalMetadata metadata;
+    et.write(metadata);
+    for (uint64_t i = 0; i < 10; ++i) {
+      ChakraProtoMsg::Node node;
+      node.set_id(i);
+      node.set_type(ChakraProtoMsg::COMP_NODE);
+      et.write(node);
+    }
+  }
+  SetUp(filename);
+  ASSERT_EQ(drainTrace(*trace).size(), 10);
+}
+
+TEST_F(ETFeederTest, MemoryBudgetTest) {
+  SetUp("tests/data/chakra.0.et");
+  std::vector<uint64_t> expected = drainTrace(*trace);
+  delete trace;
+
+  Chakra::ETFeederOptions options;
+  options.memory_budget_bytes = 16 * 1024;
+  options.collect_stats = true;
+  SetUp("tests/data/chakra.0.et", options);
+  std::shared_ptr<Chakra::ETFeederNode> first = trace->lookupNode(216);
+  ASSERT_GT(trace->graphBytes(), 0);
+  std::vector<uint64_t> issued = drainTrace(*trace);
+  std::sort(expected.begin(), expected.end());
+  std::sort(issued.begin(), issued.end());
+  ASSERT_EQ(issued, expected);
+  ASSERT_GT(trace->numBudgetStalls(), 0);
+  // Reading is only attempted once the budget allows it, so every window
+  // but the one that finds the end of the trace reads nodes, and each
+  // stall is followed by a window
+  Chakra::FeederStats stats = trace->stats();
+  for (size_t i = 0; i + 1 < stats.windows.size(); ++i) {
+    ASSERT_GT(stats.windows[i].num_nodes, 0);
+  }
+  ASSERT_LE(trace->numBudgetStalls(), stats.num_windows);
+  ASSERT_LT(trace->peakGraphBytes(), 2 * options.memory_budget_bytes);
+  ASSERT_EQ(trace->graphBytes(), 0);
+  // Removed nodes give their messages back
+  ASSERT_EQ(first->getChakraNode(), nullptr);
+  ASSERT_EQ(first->id(), 216);
+}
+
+TEST(ReadyQueueTest, PolicyOrderTest) {
+  // Node i is a collective with comm_priority i % 3 and a bottom level of
+  // 10 * (i % 4) for odd i, a compute node otherwise
+  std::vector<std::shared_ptr<Chakra::ETFeederNode>> nodes;
+  for (uint64_t i = 0; i < 8; ++i) {
+    auto msg = std::make_shared<ChakraProtoMsg::Node>();
+    msg->set_id(i);
+    msg->set_type(
+        (i % 2 == 1) ? ChakraProtoMsg::COMM_COLL_NODE
+                     : ChakraProtoMsg::COMP_NODE);
+    ChakraProtoMsg::AttributeProto* priority = msg->add_attr();
+    priority->set_name("comm_priority");
+    priority->set_int32_val(i % 3);
+    ChakraProtoMsg::AttributeProto* level = msg->add_attr();
+    level->set_name("bottom_level");
+    level->set_int64_val(10 * (i % 4));
+    nodes.push_back(std::make_shared<Chakra::ETFeederNode>(msg));
+  }
+  auto drain = [&nodes](Chakra::IssuePolicy policy) {
+    Chakra::ReadyQueue queue(policy);
+    for (uint64_t i : {5, 2, 7, 0, 3, 6, 1, 4}) {
+      queue.push(nodes[i]);
+    }
+    std::vector<uint64_t> order;
+    while (!queue.empty()) {
+      order.push_back(queue.pop()->id());
+    }
+    return order;
+  };
+  using Order = std::vector<uint64_t>;
+  ASSERT_EQ(
+      drain(Chakra::IssuePolicy::IdOrder), Order({0, 1, 2, 3, 4, 5, 6, 7}));
+  ASSERT_EQ(drain(Chakra::IssuePolicy::Fifo), Order({5, 2, 7, 0, 3, 6, 1, 4}));
+  ASSERT_EQ(
+      drain(Chakra::IssuePolicy::CommPriority),
+      Order({2, 5, 1, 4, 7, 0, 3, 6}));
+  ASSERT_EQ(
+      drain(Chakra::IssuePolicy::CriticalPath),
+      Order({3, 7, 2, 6, 1, 5, 0, 4}));
+  ASSERT_EQ(
+      drain(Chakra::IssuePolicy::CommFirst), Order({1, 3, 5, 7, 0, 2, 4, 6}));
+}
+
+TEST_F(ETFeederTest, IssuePolicyTest) {
+  Chakra::ETFeederOptions options;
+  options.issue_policy = Chakra::IssuePolicy::Fifo;
+  SetUp("tests/data/chakra.0.et", options);
+  std::vector<uint64_t> issued = drainTrace(*trace);
+  delete trace;
+  SetUp("tests/data/chakra.0.et");
+  std::vector<uint64_t> expected = drainTrace(*trace);
+  ASSERT_NE(issued, expected);
+  std::sort(issued.begin(), issued.end());
+  std::sort(expected.begin(), expected.end());
+  ASSERT_EQ(issued, expected);
+}
+
+TEST_F(ETFeederTest, CriticalPathTest) {
+  // A diamond, 0 -> {1, 2} -> 3, with its sink written first
+  std::string filename = ::testing::TempDir() + "diamond.et";
+  {
+    ProtoOutputStream et(filename);
+    ChakraProtoMsg::GlobalMetadata metadata;
+    et.write(metadata);
+    const uint64_t durations[] = {1, 2, 5, 1};
+    for (uint64_t id : {3, 0, 1, 2}) {
+      ChakraProtoMsg::Node node;
+      node.set_id(id);
+      node.set_type(ChakraProtoMsg::COMP_NODE);
+      node.set_duration_micros(durations[id]);
+      if (id == 1 || id == 2) {
+        node.add_data_deps(0);
+      } else if (id == 3) {
+        node.add_data_deps(1);
+        node.add_data_deps(2);
+      }
+      et.write(node);
+    }
+  }
+
+  std::unique_ptr<Chakra::CriticalPath> path =
+      Chakra::CriticalPath::build(filename);
+  ASSERT_EQ(path->size(), 4);
+  ASSERT_EQ(path->length(), 7);
+  uint64_t bottom_level, slack;
+  ASSERT_TRUE(path->find(1, bottom_level, slack));
+  ASSERT_EQ(bottom_level, 3);
+  ASSERT_EQ(slack, 3);
+  ASSERT_TRUE(path->find(2, bottom_level, slack));
+  ASSERT_EQ(bottom_level, 6);
+  ASSERT_EQ(slack, 0);
+  ASSERT_FALSE(path->find(4, bottom_level, slack));
+
+  // The longer branch is issued first once the levels are in the trace
+  std::string annotated = ::testing::TempDir() + "diamond_annotated.et";
+  path->annotate(filename, annotated);
+  Chakra::ETFeederOptions options;
+  options.issue_policy = Chakra::IssuePolicy::CriticalPath;
+  SetUp(annotated, options);
+  ASSERT_EQ(
+      trace->lookupNode(0)->get_attr<int64_t>(Chakra::AttrId::bottom_level),
+      7);
+  ASSERT_EQ(drainTrace(*trace), std::vector<uint64_t>({0, 2, 1, 3}));
+}
+
+TEST_F(ETFeederTest, ConcurrentTest) {
+  SetUp("tests/data/chakra.0.et");
+  std::vector<uint64_t> expected = drainTrace(*trace);
+  delete trace;
+
+  // A small queue and window, so that nodes spill over and windows are read
+  // while other threads free children
+  Chakra::ETFeederOptions options;
+  options.concurrent = true;
+  options.concurrent_queue_capacity = 16;
+  options.window_size = 64;
+  SetUp("tests/data/chakra.0.et", options);
+  std::mutex issued_mutex;
+  std::vector<uint64_t> issued;
+  std::vector<std::thread> workers;
+  for (int i = 0; i < 4; ++i) {
+    workers.emplace_back([this, &issued_mutex, &issued] {
+      while (true) {
+        std::shared_ptr<Chakra::ETFeederNode> node =
+            trace->getNextIssuableNode();
+        if (node == nullptr) {
+          if (!trace->hasNodesToIssue()) {
+            break;
+          }
+          std::this_thread::yield();
+          continue;
+        }
+        {
+          std::lock_guard<std::mutex> lock(issued_mutex);
+          issued.push_back(node->id());
+        }
+        trace->freeChildrenNodes(node->id());
+        trace->removeNode(node->id());
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  std::sort(expected.begin(), expected.end());
+  std::sort(issued.begin(), issued.end());
+  ASSERT_EQ(issued, expected);
+}
+
+TEST_F(ETFeederTest, BatchTest) {
+  SetUp("tests/data/chakra.0.et");
+  std::vector<uint64_t> expected = drainTrace(*trace);
+  delete trace;
+
+  Chakra::ETFeederOptions options;
+  options.window_size = 256;
+  SetUp("tests/data/chakra.0.et", options);
+  std::vector<uint64_t> issued;
+  std::vector<std::shared_ptr<Chakra::ETFeederNode>> nodes;
+  std::vector<uint64_t> node_ids;
+  while (trace->getNextIssuableNodes(nodes, 32) > 0) {
+    ASSERT_LE(nodes.size(), 32);
+    for (const auto& node : nodes) {
+      issued.push_back(node->id());
+      node_ids.push_back(node->id());
+    }
+    trace->retireNodes(node_ids);
+    nodes.clear();
+    node_ids.clear();
+  }
+  ASSERT_FALSE(trace->hasNodesToIssue());
+  std::sort(expected.begin(), expected.end());
+  std::sort(issued.begin(), issued.end());
+  ASSERT_EQ(issued, expected);
+}
+
+TEST_F(ETFeederTest, CheckpointTest) {
+  const std::string checkpoint = ::testing::TempDir() + "feeder.ckpt";
+  for (uint32_t num_decode_threads : {0, 2}) {
+    Chakra::ETFeederOptions options;
+    options.window_size = 64;
+    options.num_decode_threads = num_decode_threads;
+    options.decode_batch_size = 16;
+    SetUp("tests/data/chakra.0.et", options);
+    for (int i = 0; i < 1000; ++i) {
+      std::shared_ptr<Chakra::ETFeederNode> node =
+          trace->getNextIssuableNode();
+      trace->freeChildrenNodes(node->id());
+      trace->removeNode(node->id());
+    }
+    // A node in flight at the checkpoint is issued again once restored
+    std::shared_ptr<Chakra::ETFeederNode> in_flight =
+        trace->getNextIssuableNode();
+    trace->checkpoint(checkpoint);
+    trace->freeChildrenNodes(in_flight->id());
+    trace->removeNode(in_flight->id());
+    std::vector<uint64_t> expected = drainTrace(*trace);
+    expected.push_back(in_flight->id());
+    delete trace;
+    trace = nullptr;
+
+    std::unique_ptr<Chakra::ETFeeder> restored =
+        Chakra::ETFeeder::restore(checkpoint, options);
+    std::vector<uint64_t> issued = drainTrace(*restored);
+    ASSERT_FALSE(restored->hasNodesToIssue());
+    std::sort(expected.begin(), expected.end());
+    std::sort(issued.begin(), issued.end());
+    ASSERT_EQ(issued, expected);
+  }
+}
+
+TEST_F(ETFeederTest, FastForwardTest) {
+  SetUp("tests/data/chakra.0.et");
+  std::vector<uint64_t> order = drainTrace(*trace);
+  delete trace;
+
+  // The node fast forwarded to is put back at the head of the queue, so the
+  // issue order carries on as if the nodes before it had been drained, in
+  // concurrent mode too
+  for (int mode = 0; mode < 3; ++mode) {
+    Chakra::ETFeederOptions options;
+    options.issue_policy =
+        (mode == 1) ? Chakra::IssuePolicy::Fifo : Chakra::IssuePolicy::IdOrder;
+    options.concurrent = (mode == 2);
+    options.concurrent_queue_capacity = 64;
+    SetUp("tests/data/chakra.0.et", options);
+    if (mode != 0) {
+      order = drainTrace(*trace);
+      delete trace;
+      SetUp("tests/data/chakra.0.et", options);
+    }
+    ASSERT_EQ(trace->fastForward(order[2000]), 2000);
+    ASSERT_EQ(
+        drainTrace(*trace),
+        std::vector<uint64_t>(order.begin() + 2000, order.end()));
+    delete trace;
+  }
+  trace = nullptr;
+}
+
+TEST_F(ETFeederTest, StatsTest) {
+  // Every node but the last depends on the last one
+  std::string filename = ::testing::TempDir() + "stats.et";
+  {
+    ProtoOutputStream et(filename);
+    ChakraProtoMsg::GlobalMetadata metadata;
+    et.write(metadata);
+    for (uint64_t i = 0; i < 1000; ++i) {
+      ChakraProtoMsg::Node node;
+      node.set_id(i);
+      node.set_type(ChakraProtoMsg::COMP_NODE);
+      if (i + 1 < 1000) {
+        node.add_data_deps(999);
+      }
+      et.write(node);
+    }
+  }
+  SetUp(filename);
+  drainTrace(*trace);
+  ASSERT_EQ(trace->stats().num_windows, 0);
+  delete trace;
+
+  Chakra::ETFeederOptions options;
+  options.window_size = 64;
+  options.collect_stats = true;
+  SetUp(filename, options);
+  ASSERT_EQ(drainTrace(*trace).size(), 1000);
+  Chakra::FeederStats stats = trace->stats();
+  ASSERT_EQ(stats.num_nodes_read, 1000);
+  ASSERT_EQ(stats.windows.size(), stats.num_windows);
+  ASSERT_EQ(stats.window_nodes.sum(), 1000);
+  ASSERT_GE(stats.node_read_ns.count(), 1000);
+  // Nothing is issuable before the last node is read
+  ASSERT_EQ(stats.peak_unresolved_nodes, 999);
+  ASSERT_EQ(stats.windows.front().num_issuable_nodes, 1);
+  // A mapped file is read as it is
+  std::ifstream file(filename, std::ios::in | std::ios::binary | std::ios::ate);
+  ASSERT_EQ(stats.bytes_read, static_cast<uint64_t>(file.tellg()));
+  ASSERT_EQ(stats.bytes_decompressed, stats.bytes_read);
+  delete trace;
+
+  options.prefetch = true;
+  SetUp(writeBlockTrace("tests/data/chakra.0.et", 100), options);
+  ASSERT_EQ(drainTrace(*trace).size(), 3664);
+  stats = trace->stats();
+  ASSERT_EQ(stats.num_nodes_read, 3664);
+  ASSERT_GT(stats.num_windows, 1);
+  ASSERT_GT(stats.bytes_read, 0);
+  ASSERT_LT(stats.bytes_read, stats.bytes_decompressed);
+
+  std::string chrome_trace = ::testing::TempDir() + "feeder_stats.json";
+  stats.writeChromeTrace(chrome_trace);
+  std::ifstream json(chrome_trace);
+  std::string contents(
+      (std::istreambuf_iterator<char>(json)), std::istreambuf_iterator<char>());
+  ASSERT_EQ(contents.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0);
+  ASSERT_NE(contents.find("\"name\":\"readNextWindow\",\"ph\":\"X\""),
+            std::string::npos);
+  ASSERT_NE(contents.find("\"otherData\":" + stats.toJson()),
+            std::string::npos);
+}
+
+TEST_F(ETFeederTest, IndexTest) {
+  std::unique_ptr<Chakra::ETIndex> index =
+      Chakra::ETIndex::build("tests/data/chakra.0.et");
+  ASSERT_EQ(index->size(), 3664);
+  std::string index_filename = ::testing::TempDir() + "chakra.0.et.etidx";
+  index->write(index_filename, "tests/data/chakra.0.et");
+
+  Chakra::ETFeederOptions options;
+  options.window_size = 64;
+  options.index_filename = index_filename;
+  SetUp("tests/data/chakra.0.et", options);
+  ASSERT_TRUE(trace->hasIndex());
+
+  // The last node of the trace is far outside the first window
+  ProtoInputStream plain("tests/data/chakra.0.et");
+  ChakraProtoMsg::GlobalMetadata metadata;
+  ChakraProtoMsg::Node last, node;
+  plain.read(metadata);
+  while (plain.read(node)) {
+    last = node;
+  }
+  std::shared_ptr<Chakra::ETFeederNode> fetched = trace->lookupNode(last.id());
+  ASSERT_EQ(fetched->id(), last.id());
+  ASSERT_EQ(fetched->name(), last.name());
+  ASSERT_EQ(trace->fetchNode(216)->get_other_attr("rf_id").int64_val(), 2);
+  ASSERT_EQ(trace->fetchNode(last.id() + 1000000), nullptr);
+
+  options.use_mmap = false;
+  Chakra::ETFeeder stream_feeder("tests/data/chakra.0.et", options);
+  ASSERT_EQ(stream_feeder.lookupNode(last.id())->name(), last.name());
+  options.use_mmap = true;
+
+  // Block containers are indexed by offset in the uncompressed stream
+  std::string block_filename =
+      writeBlockTrace("tests/data/chakra.0.et", 100);
+  Chakra::ETIndex::build(block_filename)
+      ->write(Chakra::ETIndex::defaultFilename(block_filename), block_filename);
+  options.index_filename = "";
+  Chakra::ETFeeder block_feeder(block_filename, options);
+  ASSERT_TRUE(block_feeder.hasIndex());
+  ASSERT_EQ(block_feeder.lookupNode(last.id())->name(), last.name());
+  ASSERT_EQ(block_feeder.fetchNode(216)->id(), 216);
+
+  // An index built for another trace is ignored
+  options.index_filename = index_filename;
+  Chakra::ETFeeder stale_feeder(block_filename, options);
+  ASSERT_FALSE(stale_feeder.hasIndex());
+
+  // So is a truncated one, whatever entry count its header gives
+  std::string truncated_filename = ::testing::TempDir() + "truncated.etidx";
+  {
+    std::ifstream in(index_filename, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), {});
+    std::ofstream out(truncated_filename, std::ios::binary);
+    out.write(data.data(), data.size() - 8);
+  }
+  ASSERT_EQ(
+      Chakra::ETIndex::load(truncated_filename, "tests/data/chakra.0.et"),
+      nullptr);
+}
+
+TEST_F(ETFeederTest, GroupTest) {
+  const uint32_t num_ranks = 8;
+  Chakra::ETFeederGroupOptions options;
+  options.max_open_traces = 2;
+  options.num_decode_threads = 2;
+  options.max_window_nodes = num_ranks * 64;
+  Chakra::ETFeederGroup group(
+      std::vector<std::string>(num_ranks, "tests/data/chakra.0.et"), options);
+  ASSERT_EQ(group.numRanks(), num_ranks);
+  ASSERT_LE(group.numOpenTraces(), 2);
+
+  // Only two traces stay open, so ranks reopen theirs as they are drained
+  std::vector<std::vector<uint64_t>> issued(num_ranks);
+  std::shared_ptr<Chakra::ETFeederNode> node;
+  uint32_t rank;
+  while ((node = group.getNextIssuableNodeAnyRank(rank)) != nullptr) {
+    issued[rank].push_back(node->id());
+    group.freeChildrenNodes(rank, node->id());
+    group.removeNode(rank, node->id());
+    ASSERT_LE(group.numOpenTraces(), 2);
+  }
+
+  Chakra::ETFeederOptions reference_options;
+  reference_options.window_size = 64;
+  SetUp("tests/data/chakra.0.et", reference_options);
+  std::vector<uint64_t> expected = drainTrace(*trace);
+  for (rank = 0; rank < num_ranks; ++rank) {
+    ASSERT_EQ(issued[rank], expected);
+    ASSERT_FALSE(group.hasNodesToIssue(rank));
+  }
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
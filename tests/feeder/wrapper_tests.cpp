@@ -1,13 +1,32 @@
 #include <gtest/gtest.h>
-#include "WrapperNode.h"
+#include <algorithm>
+#include <fstream>
+#include "et_converter.h"
+#include "wrapper_node.h"
+
+namespace {
+// Issues and completes every node one at a time, returning the node IDs in
+// issue order
+std::vector<uint64_t> drainWrapper(WrapperNode& node) {
+  std::vector<uint64_t> issued;
+  node.getNextIssuableNode();
+  while (node.isValidNode()) {
+    issued.push_back(node.getNodeID());
+    node.freeChildrenNodes(node.getNodeID());
+    node.removeNode(node.getNodeID());
+    node.getNextIssuableNode();
+  }
+  return issued;
+}
+} // namespace
 
 class WrapperNodeTest : public ::testing::Test {
  protected:
   WrapperNodeTest() {}
   virtual ~WrapperNodeTest() {}
 
-  void SetUp(const std::string& filename) {
-    node.createWrapper(filename);
+  void SetUp(const std::string& filename, int json_window_size = 4096 * 256) {
+    node.createWrapper(filename, json_window_size);
   }
 
   virtual void TearDown() {
@@ -68,14 +87,14 @@ TEST_F(WrapperNodeTest, RemoveTest) {
   node.lookupNode(216);
   ASSERT_EQ(node.getNodeID(), 216);
   node.removeNode(216);
-  freopen("/dev/null", "w", stderr);
+  testing::internal::CaptureStderr();
   try {
     node.lookupNode(216);
     ASSERT_TRUE(false) << "node should be removed \n";
   } catch (const std::exception& e) {
     // this is the desired behaviour
   }
-  freopen("/dev/tty", "w", stderr);
+  testing::internal::GetCapturedStderr();
 }
 
 TEST_F(WrapperNodeTest, RemoveAndGetNextTest) {
@@ -131,7 +150,7 @@ TEST_F(WrapperNodeTest, AddNodeTest) {
     pnode2 = node.getProtobufNode();
     ASSERT_EQ(pnode2->id(), 216);
   } else if (ext == "json") {
-    JSON jnode1;
+    JSONNode jnode1;
     node.lookupNode(216);
     jnode1 = node.getJSONNode();
     node.removeNode(216);
@@ -161,6 +180,322 @@ TEST_F(WrapperNodeTest, NodeGetChildrenTest) {
   }
 }
 
+TEST(JSONTraceReaderTest, ReadTest) {
+  // Members before the graph are skipped, whatever their strings hold
+  std::string filename = ::testing::TempDir() + "reader_test.json";
+  {
+    std::ofstream file(filename);
+    file << "{\"workload_name\": \"a \\\"[{\", \"soc\": {\"x\": [1, {}]},"
+         << " \"ngpus\": 8, \"workload_graph\": [ {\"Id\": 3,"
+         << " \"Name\": \"}]\", \"data_deps\": []},\n"
+         << "{\"Id\": 5, \"Name\": \"b\", \"data_deps\": [3]} ], \"end\": 1}";
+  }
+  // A small chunk size makes values span reads
+  JSONTraceReader reader(filename, 5);
+  ASSERT_TRUE(reader.is_open());
+  json node;
+  ASSERT_TRUE(reader.next(node));
+  ASSERT_EQ(node["Id"], 3);
+  ASSERT_EQ(node["Name"], "}]");
+  ASSERT_TRUE(reader.next(node));
+  ASSERT_EQ(node["Id"], 5);
+  ASSERT_EQ(node["data_deps"][0], 3);
+  ASSERT_FALSE(reader.next(node));
+  ASSERT_EQ(reader.numNodesRead(), 2);
+}
+
+TEST(JSONNodeTableTest, DecodeTest) {
+  JSONNodeTable table;
+  testing::internal::CaptureStderr();
+  uint32_t row = table.append(json::parse(
+      R"({"Id": 7, "Name": "a", "NodeType": 7, "is_cpu_op": false,
+          "data_deps": [3, 5], "runtime": 12, "comm_size": 64})"));
+  // Missing fields read as 0
+  uint32_t empty_row = table.append(json::parse(R"({"Id": 9})"));
+  testing::internal::GetCapturedStderr();
+  ASSERT_EQ(table.size(), 2);
+  ASSERT_EQ(table.findRow(7), row);
+  ASSERT_EQ(table.findRow(9), empty_row);
+  ASSERT_EQ(table.findRow(8), JSONNodeTable::kNoRow);
+  ASSERT_EQ(table.name(row), "a");
+  ASSERT_EQ(table.type(row), COMM_COLL_NODE);
+  ASSERT_EQ(table.runtime(row), 12);
+  ASSERT_EQ(table.commSize(row), 64);
+  ASSERT_EQ(
+      std::vector<uint64_t>(table.dataDepsBegin(row), table.dataDepsEnd(row)),
+      std::vector<uint64_t>({3, 5}));
+  ASSERT_EQ(table.name(empty_row), "");
+  ASSERT_EQ(table.runtime(empty_row), 0);
+  ASSERT_EQ(table.dataDepsBegin(empty_row), table.dataDepsEnd(empty_row));
+
+  // A released row is reused, with nothing left over from its last node
+  table.addChild(row, empty_row);
+  table.addUnfinishedParent(row);
+  table.releaseRow(row);
+  ASSERT_EQ(table.size(), 1);
+  ASSERT_EQ(table.findRow(7), JSONNodeTable::kNoRow);
+  testing::internal::CaptureStderr();
+  ASSERT_EQ(table.append(json::parse(R"({"Id": 8})")), row);
+  testing::internal::GetCapturedStderr();
+  ASSERT_EQ(table.size(), 2);
+  ASSERT_EQ(table.findRow(8), row);
+  ASSERT_EQ(table.name(row), "");
+  ASSERT_EQ(table.runtime(row), 0);
+  ASSERT_EQ(table.dataDepsBegin(row), table.dataDepsEnd(row));
+  ASSERT_TRUE(table.children(row).empty());
+  ASSERT_EQ(table.numUnfinishedParents(row), 0);
+}
+
+TEST_F(WrapperNodeTest, GetterTest) {
+  SetUp("tests/data/small_chakra.0.json");
+  node.lookupNode(435);
+  ASSERT_EQ(node.getNodeID(), 435);
+  ASSERT_EQ(node.getNodeType(), ChakraProtoMsg::COMM_COLL_NODE);
+  ASSERT_EQ(node.getRuntime(), 28);
+  ASSERT_FALSE(node.isCPUOp());
+  ASSERT_EQ(node.findNodeIndexJSON(435), 5);
+  ASSERT_EQ(node.findNodeIndexJSON(1), -1);
+}
+
+TEST(JSONNodeTest, HandleTest) {
+  auto table = std::make_shared<JSONNodeTable>();
+  JSONNode parent(table, table->append(json::parse(R"({"Id": 1})")));
+  JSONNode child(table, table->append(json::parse(R"({"Id": 2})")));
+  // Copies refer to the same node, so graph state set through one of them
+  // is seen through the others
+  JSONNode copy = child;
+  ASSERT_EQ(copy, child);
+  parent.addChild(copy);
+  copy.addUnfinishedParent();
+  ASSERT_EQ(child.getNumUnfinishedParents(), 1);
+  std::vector<JSONNode> children = parent.getChildren();
+  ASSERT_EQ(children.size(), 1);
+  ASSERT_EQ(children[0].id(), 2);
+  ASSERT_EQ(children[0].removeUnfinishedParent(), 0);
+  ASSERT_EQ(child.getNumUnfinishedParents(), 0);
+}
+
+TEST_F(WrapperNodeTest, WindowTest) {
+  SetUp("tests/data/chakra.0.json");
+  std::vector<uint64_t> expected = drainWrapper(node);
+  // Nodes with several parents are issued once all of them are freed
+  ASSERT_EQ(expected.size(), 3664);
+  node.releaseMemory();
+
+  // Small windows issue the same nodes, only in a different order
+  SetUp("tests/data/chakra.0.json", 64);
+  std::vector<uint64_t> issued = drainWrapper(node);
+  std::sort(expected.begin(), expected.end());
+  std::sort(issued.begin(), issued.end());
+  ASSERT_EQ(issued, expected);
+}
+
+TEST_F(WrapperNodeTest, RowReuseTest) {
+  // Independent nodes, so that the graph holds about two windows at a time
+  std::string filename = ::testing::TempDir() + "row_reuse.json";
+  {
+    std::ofstream out(filename);
+    out << "{\"workload_graph\": [";
+    for (int i = 0; i < 1000; ++i) {
+      out << (i ? ", " : "") << "{\"Id\": " << i << ", \"Name\": \"n\", "
+          << "\"NodeType\": 4, \"is_cpu_op\": false, \"data_deps\": []}";
+    }
+    out << "]}";
+  }
+  SetUp(filename, 16);
+  // Removed nodes hand their rows to the nodes read after them
+  uint32_t max_row = 0;
+  uint64_t num_issued = 0;
+  node.getNextIssuableNode();
+  while (node.isValidNode()) {
+    max_row = std::max(max_row, node.getJSONNode().row());
+    ++num_issued;
+    node.freeChildrenNodes(node.getNodeID());
+    node.removeNode(node.getNodeID());
+    node.getNextIssuableNode();
+  }
+  ASSERT_EQ(num_issued, 1000);
+  ASSERT_LT(max_row, 64);
+  ASSERT_EQ(node.findNodeIndexJSON(999), -1);
+}
+
+TEST_F(WrapperNodeTest, RemoveAndAddBackTest) {
+  // A window this small reads the next nodes right when one is removed
+  SetUp("tests/data/small_chakra.0.json", 4);
+  node.lookupNode(216);
+  JSONNode removed = node.getJSONNode();
+  node.removeNode(216);
+  // The row of a removed node is kept while a handle refers to it
+  ASSERT_EQ(removed.id(), 216);
+  node.addNode(removed);
+  node.lookupNode(216);
+  ASSERT_EQ(node.getJSONNode().id(), 216);
+  // Only the children read before the remove link to it
+  std::vector<JSONNode> children;
+  node.getChildren(children);
+  ASSERT_EQ(children.size(), 2);
+  ASSERT_EQ(children[0].id(), 217);
+  ASSERT_EQ(children[1].id(), 430);
+}
+
+TEST_F(WrapperNodeTest, SelectedAfterRemoveTest) {
+  SetUp("tests/data/small_chakra.0.json", 4);
+  node.getNextIssuableNode();
+  node.freeChildrenNodes(216);
+  node.removeNode(216);
+  // The selected node still reads as itself
+  ASSERT_EQ(node.getNodeID(), 216);
+  ASSERT_EQ(node.getJSONNode().id(), 216);
+  std::vector<JSONNode> children;
+  node.getChildren(children);
+  ASSERT_EQ(children.size(), 2);
+  ASSERT_EQ(children[1].id(), 430);
+  std::vector<uint64_t> issued = drainWrapper(node);
+  ASSERT_EQ(issued.front(), 217);
+}
+
+TEST_F(WrapperNodeTest, LazyFieldsTest) {
+  SetUp("tests/data/chakra.0.et");
+  node.lookupNode(216);
+  std::shared_ptr<Chakra::ETFeederNode> first = node.getProtobufNode();
+  // A copy shares the trace, but the fields of the node selected through
+  // the original are read from that node even after the copy selects
+  // another one
+  WrapperNode copy(node);
+  copy.lookupNode(435);
+  ASSERT_EQ(node.getNodeID(), 216);
+  ASSERT_EQ(node.getNodeName(), first->name());
+  ASSERT_EQ(node.isCPUOp(), first->is_cpu_op());
+  ASSERT_EQ(node.getRuntime(), first->runtime());
+  ASSERT_EQ(copy.getNodeID(), 435);
+  ASSERT_EQ(copy.getNodeType(), ChakraProtoMsg::COMM_COLL_NODE);
+  ASSERT_EQ(copy.getNodeName(), copy.getProtobufNode()->name());
+  ASSERT_EQ(copy.getCommSize(), copy.getProtobufNode()->comm_size());
+}
+
+TEST_F(WrapperNodeTest, CopySelectTest) {
+  // The node handles and children of the original are those of the node it
+  // selected, whichever node the copy selects next
+  SetUp("tests/data/chakra.0.et");
+  node.getNextIssuableNode();
+  WrapperNode copy(node);
+  copy.getNextIssuableNode();
+  ASSERT_EQ(node.getNodeID(), 216);
+  ASSERT_EQ(node.getProtobufNode()->id(), 216);
+  ASSERT_NE(copy.getProtobufNode()->id(), 216);
+  std::vector<std::shared_ptr<Chakra::ETFeederNode>> children;
+  node.getChildren(children);
+  ASSERT_EQ(children[0]->id(), 217);
+  ASSERT_EQ(children[2]->id(), 435);
+  node.releaseMemory();
+
+  SetUp("tests/data/small_chakra.0.json");
+  node.getNextIssuableNode();
+  WrapperNode json_copy(node);
+  json_copy.getNextIssuableNode();
+  ASSERT_EQ(node.getNodeID(), 216);
+  ASSERT_EQ(node.getJSONNode().id(), 216);
+  ASSERT_EQ(json_copy.getJSONNode().id(), 432);
+  std::vector<JSONNode> json_children;
+  node.getChildren(json_children);
+  ASSERT_EQ(json_children[0].id(), 217);
+  ASSERT_EQ(json_children[2].id(), 435);
+}
+
+TEST_F(WrapperNodeTest, QueueTest) {
+  SetUp("tests/data/small_chakra.0.json");
+  node.getNextIssuableNode();
+  ASSERT_EQ(node.getNodeID(), 216);
+  node.push_to_queue();
+  node.lookupNode(435);
+  ASSERT_FALSE(node.is_queue_empty());
+  // The fields of the node at the front are read again
+  node.queue_front();
+  ASSERT_EQ(node.getNodeID(), 216);
+  ASSERT_EQ(node.getNodeName(), node.getJSONNode().name());
+  node.pop_from_queue();
+  ASSERT_TRUE(node.is_queue_empty());
+}
+
+TEST_F(WrapperNodeTest, FormatTest) {
+  SetUp("tests/data/chakra.0.json");
+  std::vector<uint64_t> expected = drainWrapper(node);
+  node.releaseMemory();
+
+  // Both formats of a trace issue the same nodes
+  SetUp("tests/data/chakra.0.et");
+  std::vector<uint64_t> issued = drainWrapper(node);
+  std::sort(expected.begin(), expected.end());
+  std::sort(issued.begin(), issued.end());
+  ASSERT_EQ(issued, expected);
+}
+
+TEST_F(WrapperNodeTest, ConvertTest) {
+  std::string filename = ::testing::TempDir() + "small_chakra.0.et";
+  testing::internal::CaptureStderr();
+  ASSERT_EQ(
+      Chakra::convertJSONTrace("tests/data/small_chakra.0.json", filename), 7);
+  testing::internal::GetCapturedStderr();
+  {
+    ProtoInputStream trace(filename);
+    ChakraProtoMsg::GlobalMetadata metadata;
+    ASSERT_TRUE(trace.read(metadata));
+    ASSERT_EQ(metadata.version(), Chakra::kChakraSchemaVersion);
+  }
+
+  // The converted trace reads back the same fields
+  SetUp("tests/data/small_chakra.0.json");
+  node.lookupNode(435);
+  WrapperNode converted(filename);
+  converted.lookupNode(435);
+  ASSERT_EQ(converted.getNodeName(), node.getNodeName());
+  ASSERT_EQ(converted.getNodeType(), node.getNodeType());
+  ASSERT_EQ(converted.isCPUOp(), node.isCPUOp());
+  ASSERT_EQ(converted.getRuntime(), node.getRuntime());
+  ASSERT_EQ(converted.getCommType(), node.getCommType());
+  ASSERT_EQ(converted.getCommSize(), node.getCommSize());
+  std::vector<uint64_t> expected = drainWrapper(node);
+  std::vector<uint64_t> issued = drainWrapper(converted);
+  converted.releaseMemory();
+  std::sort(expected.begin(), expected.end());
+  std::sort(issued.begin(), issued.end());
+  ASSERT_EQ(issued, expected);
+}
+
+TEST(ConverterTest, ReencodeTest) {
+  // Node i depends on node i + 1, which comes after it
+  std::string filename = ::testing::TempDir() + "reencode_test.et";
+  {
+    ProtoOutputStream et(filename);
+    ChakraProtoMsg::GlobalMetadata metadata;
+    et.write(metadata);
+    for (uint64_t i = 0; i < 4; ++i) {
+      ChakraProtoMsg::Node node;
+      node.set_id(i);
+      if (i + 1 < 4) {
+        node.add_data_deps(i + 1);
+      }
+      et.write(node);
+    }
+  }
+
+  // Nodes come after their parents, in a block-compressed copy
+  std::string reencoded = ::testing::TempDir() + "reencode_test.zb";
+  ASSERT_EQ(
+      Chakra::reencodeTrace(
+          filename, reencoded, Chakra::TraceOrder::Topological),
+      4);
+  ProtoInputStream trace(reencoded);
+  ChakraProtoMsg::GlobalMetadata metadata;
+  ASSERT_TRUE(trace.read(metadata));
+  std::vector<uint64_t> ids;
+  ChakraProtoMsg::Node node;
+  while (trace.read(node)) {
+    ids.push_back(node.id());
+  }
+  ASSERT_EQ(ids, std::vector<uint64_t>({3, 2, 1, 0}));
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();